@@ -0,0 +1,348 @@
+// deblock_replay.c : Replays deblock test vectors (deblock_test.txt) through the deblocking engines.
+// Checks the ring model writes against the logged outputs, the fast engine against the ring model picture,
+// and reports the throughput of each engine. No encoder or yuv file needed.
+//
+// Build: deblock_replay.c gg_deblock.c gg_process_tables.c (gg_deblock.c without LOG_DEBLOCK, it would rewrite deblock_test.txt)
+// Usage: deblock_replay [deblock_test.txt [iterations [slice_rows]]]
+//
+// Records, as written by the model and read by gg_deblock_testbench.sv:
+//   0 - frame: disable_deblock_filter_idc filterOffsetA filterOffsetB mb_width-1 mb_height-1
+//   1 - macroblock: mbx mby qp mb_type refidx mvx mvy
+//   2 - filtered output block: write mask (0-ale, 1-abv, 2-lef, 3-cur), 16 pels
+//   3 - input block: cidx (0-y, 2-cb, 3-cr) bidx num_coeff!=0, 16 pels
+//   4 - step, the end of a hardware cycle
+// Slice starts are not logged, a picture is replayed as one slice or as slices of slice_rows mb rows (idc 2).
+
+#define _CRT_SECURE_NO_WARNINGS 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gg_process.h"
+#include "gg_deblock.h"
+
+#define REPLAY_ITERATIONS 200
+
+typedef struct _ReplayMb {
+    int mbx;
+    int mby;
+    int qp;
+    int mb_type;
+    int refidx;
+    int mvx; // quarter samples, logged as 16 bit two's complement
+    int mvy;
+    int num_coeff_y[16]; // decode order, only zero/non zero is logged
+    int num_coeff_cb[4];
+    int num_coeff_cr[4];
+    unsigned char blk[24][16]; // unfiltered recon, y 0-15, cb 16-19, cr 20-23 in decode order
+} ReplayMb;
+
+typedef struct _ReplayOut {
+    int dir;
+    unsigned char d[16];
+} ReplayOut;
+
+typedef struct _ReplayFrame {
+    int disable_deblock_filter_idc;
+    int filterOffsetA;
+    int filterOffsetB;
+    int mb_width;
+    int mb_height;
+    ReplayMb* mb;
+    int num_mb;
+    ReplayOut* out;
+    int num_out;
+} ReplayFrame;
+
+typedef struct _ReplayPic {
+    char* y;
+    char* cb;
+    char* cr;
+    int stride_y;
+    int stride_c;
+} ReplayPic;
+
+// Ring model output check
+typedef struct _ReplayCheck {
+    const ReplayFrame* fr;
+    const ReplayMb* mb; // being filtered
+    int idx; // next expected output
+    int errors;
+} ReplayCheck;
+
+ReplayFrame* frames;
+int num_frames;
+int slice_rows = 0; // 0-one slice per picture
+
+static void* grow(void* p, int num, int* max, size_t size)
+{
+    if (num < *max)
+        return(p);
+    *max = (*max) ? *max * 2 : 64;
+    p = realloc(p, *max * size);
+    if (!p) {
+        printf("ERROR: out of memory for test vectors\n");
+        exit(-1);
+    }
+    return(p);
+}
+
+static int read_pels(FILE* fp, unsigned char* d)
+{
+    unsigned int v;
+    for (int ii = 0; ii < 16; ii++) {
+        if (fscanf(fp, "%x", &v) != 1)
+            return(-1);
+        d[ii] = (unsigned char)v;
+    }
+    return(0);
+}
+
+int load_vectors(const char* name)
+{
+    FILE* fp = fopen(name, "r");
+    unsigned int cmd, v[7];
+    int max_frames = 0, max_mb = 0, max_out = 0;
+    ReplayFrame* fr = NULL;
+    ReplayMb* mb = NULL;
+
+    if (!fp) {
+        printf("ERROR: cannot open %s\n", name);
+        return(-1);
+    }
+    while (fscanf(fp, "%x", &cmd) == 1) {
+        if (cmd == 0) {
+            if (fscanf(fp, "%x %x %x %x %x", &v[0], &v[1], &v[2], &v[3], &v[4]) != 5)
+                break;
+            frames = (ReplayFrame*)grow(frames, num_frames, &max_frames, sizeof(ReplayFrame));
+            fr = &frames[num_frames++];
+            memset(fr, 0, sizeof(ReplayFrame));
+            fr->disable_deblock_filter_idc = (int)v[0];
+            fr->filterOffsetA = (int)v[1];
+            fr->filterOffsetB = (int)v[2];
+            fr->mb_width = (int)v[3] + 1;
+            fr->mb_height = (int)v[4] + 1;
+            mb = NULL;
+            max_mb = max_out = 0;
+        }
+        else if (cmd == 1 && fr) {
+            if (fscanf(fp, "%x %x %x %x %x %x %x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+                break;
+            if ((int)v[0] >= fr->mb_width || (int)v[1] >= fr->mb_height) {
+                printf("ERROR: mb[%x,%x] outside the %dx%d mb picture\n", v[0], v[1], fr->mb_width, fr->mb_height);
+                break;
+            }
+            fr->mb = (ReplayMb*)grow(fr->mb, fr->num_mb, &max_mb, sizeof(ReplayMb));
+            mb = &fr->mb[fr->num_mb++];
+            memset(mb, 0, sizeof(ReplayMb));
+            mb->mbx = (int)v[0];
+            mb->mby = (int)v[1];
+            mb->qp = (int)v[2];
+            mb->mb_type = (int)v[3];
+            mb->refidx = (int)v[4];
+            mb->mvx = (short)v[5];
+            mb->mvy = (short)v[6];
+        }
+        else if (cmd == 2 && fr) {
+            if (fscanf(fp, "%x", &v[0]) != 1)
+                break;
+            fr->out = (ReplayOut*)grow(fr->out, fr->num_out, &max_out, sizeof(ReplayOut));
+            fr->out[fr->num_out].dir = (int)v[0];
+            if (read_pels(fp, fr->out[fr->num_out++].d))
+                break;
+        }
+        else if (cmd == 3 && mb) {
+            if (fscanf(fp, "%x %x %x", &v[0], &v[1], &v[2]) != 3 || v[1] > 15 || (v[0] && v[1] > 3))
+                break;
+            if (v[0] == 0) {
+                mb->num_coeff_y[v[1]] = (int)v[2];
+                if (read_pels(fp, mb->blk[v[1]]))
+                    break;
+            }
+            else {
+                if (v[0] == 2)
+                    mb->num_coeff_cb[v[1]] = (int)v[2];
+                else
+                    mb->num_coeff_cr[v[1]] = (int)v[2];
+                if (read_pels(fp, mb->blk[((v[0] == 2) ? 16 : 20) + v[1]]))
+                    break;
+            }
+        }
+        else if (cmd != 4) {
+            break;
+        }
+    }
+    if (!feof(fp)) {
+        printf("ERROR: bad record in %s\n", name);
+        fclose(fp);
+        return(-1);
+    }
+    fclose(fp);
+    return(0);
+}
+
+// Unfiltered picture from the input blocks
+static void build_pic(const ReplayFrame* fr, ReplayPic* pic)
+{
+    for (int ii = 0; ii < fr->num_mb; ii++) {
+        const ReplayMb* mb = &fr->mb[ii];
+        for (int bidx = 0; bidx < 24; bidx++) {
+            int blkx = ((bidx & 1) ? 1 : 0) + ((bidx < 16) ? ((bidx & 4) ? 2 : 0) : 0);
+            int blky = ((bidx & 2) ? 1 : 0) + ((bidx < 16) ? ((bidx & 8) ? 2 : 0) : 0);
+            for (int py = 0; py < 4; py++) {
+                if (bidx < 16)
+                    memcpy(&pic->y[(mb->mby * 16 + blky * 4 + py) * pic->stride_y + mb->mbx * 16 + blkx * 4], &mb->blk[bidx][py * 4], 4);
+                else
+                    memcpy(&((bidx < 20) ? pic->cb : pic->cr)[(mb->mby * 8 + blky * 4 + py) * pic->stride_c + mb->mbx * 8 + blkx * 4], &mb->blk[bidx][py * 4], 4);
+            }
+        }
+    }
+}
+
+static void check_out(void* arg, const BlkPix* b, int dir)
+{
+    ReplayCheck* chk = (ReplayCheck*)arg;
+    if (chk->idx >= chk->fr->num_out || chk->fr->out[chk->idx].dir != dir || memcmp(chk->fr->out[chk->idx].d, b->d, 16)) {
+        if (chk->errors < 8)
+            printf("ERROR: Filtered mismatch mb[%x,%x], output %d, mask %x\n", chk->mb->mbx, chk->mb->mby, chk->idx, dir);
+        chk->errors++;
+    }
+    chk->idx++;
+}
+
+static double now()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return(ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+// Filter the picture in place, returns the seconds taken
+static double replay_frame(DeblockCtx* dbp, const ReplayFrame* fr, ReplayPic* pic, ReplayCheck* chk)
+{
+    double start = now();
+    gg_deblock_init(dbp, fr->disable_deblock_filter_idc, fr->filterOffsetA, fr->filterOffsetB, fr->mb_width, fr->mb_height, pic->stride_y, pic->stride_c);
+    for (int ii = 0; ii < fr->num_mb; ii++) {
+        ReplayMb* mb = &fr->mb[ii];
+        if (chk)
+            chk->mb = mb;
+        if (slice_rows && mb->mbx == 0 && mb->mby % slice_rows == 0)
+            gg_deblock_init_slice(dbp, mb->mby * fr->mb_width);
+        gg_deblock_mb(dbp, mb->mbx, mb->mby, pic->y, pic->cb, pic->cr, mb->num_coeff_y, mb->num_coeff_cb, mb->num_coeff_cr, mb->qp, mb->refidx, mb->mvx, mb->mvy, mb->mb_type);
+    }
+    gg_deblock_wait_rows(dbp, pic->y, fr->mb_height);
+    gg_deblock_close();
+    return(now() - start);
+}
+
+static int pic_alloc(const ReplayFrame* fr, ReplayPic* pic)
+{
+    size_t size_y, size_c;
+    pic->stride_y = fr->mb_width * 16;
+    pic->stride_c = fr->mb_width * 8;
+    size_y = (size_t)pic->stride_y * fr->mb_height * 16;
+    size_c = (size_t)pic->stride_c * fr->mb_height * 8;
+    pic->y = (char*)malloc(size_y + 2 * size_c);
+    if (!pic->y) {
+        printf("ERROR: out of memory for the picture\n");
+        return(-1);
+    }
+    pic->cb = pic->y + size_y;
+    pic->cr = pic->cb + size_c;
+    return(0);
+}
+
+static size_t pic_size(const ReplayFrame* fr)
+{
+    return((size_t)fr->mb_width * fr->mb_height * 384);
+}
+
+int main(int argc, char** argv)
+{
+    const char* name = "deblock_test.txt";
+    int iterations = REPLAY_ITERATIONS;
+    const char* engine_name[3] = { "ring", "fast", "fast, row thread" };
+    double secs[3] = { 0, 0, 0 };
+    long long num_mb = 0;
+    int errors = 0;
+
+    if (argc > 1)
+        name = argv[1];
+    if (argc > 2)
+        iterations = atoi(argv[2]);
+    if (argc > 3)
+        slice_rows = atoi(argv[3]);
+    if (load_vectors(name))
+        return(-1);
+    if (!num_frames) {
+        printf("ERROR: no frames in %s\n", name);
+        return(-1);
+    }
+
+    for (int ff = 0; ff < num_frames; ff++) {
+        ReplayFrame* fr = &frames[ff];
+        ReplayPic in, ring, pic;
+        ReplayCheck chk;
+        DeblockCtx dbp;
+        int diff = 0;
+
+        if (pic_alloc(fr, &in) || pic_alloc(fr, &ring) || pic_alloc(fr, &pic))
+            return(-1);
+        memset(in.y, 0, pic_size(fr));
+        build_pic(fr, &in);
+
+        // Ring model, writes against the logged outputs
+        memset(&chk, 0, sizeof(chk));
+        chk.fr = fr;
+        memset(&dbp, 0, sizeof(dbp));
+        gg_deblock_open(&dbp, GG_DEBLOCK_RING, 0);
+        dbp.log_out = check_out;
+        dbp.log_arg = &chk;
+        memcpy(ring.y, in.y, pic_size(fr));
+        replay_frame(&dbp, fr, &ring, &chk);
+        if (chk.idx != fr->num_out) {
+            printf("ERROR: ring model wrote %d blocks, %d logged\n", chk.idx, fr->num_out);
+            chk.errors++;
+        }
+        gg_deblock_free(&dbp);
+
+        // Fast engine, picture against the ring model
+        memset(&dbp, 0, sizeof(dbp));
+        gg_deblock_open(&dbp, GG_DEBLOCK_FAST, 0);
+        memcpy(pic.y, in.y, pic_size(fr));
+        replay_frame(&dbp, fr, &pic, NULL);
+        for (size_t ii = 0; ii < pic_size(fr); ii++)
+            diff += (pic.y[ii] != ring.y[ii]) ? 1 : 0;
+        if (diff)
+            printf("ERROR: fast engine differs from the ring model in %d samples\n", diff);
+        gg_deblock_free(&dbp);
+
+        printf("Frame %d: %dx%d mbs, %d coded, idc %d, offsets %d %d, %d outputs, ring %s, fast %s\n", ff, fr->mb_width, fr->mb_height, fr->num_mb,
+            fr->disable_deblock_filter_idc, fr->filterOffsetA, fr->filterOffsetB, fr->num_out, (chk.errors) ? "FAIL" : "ok", (diff) ? "FAIL" : "ok");
+        errors += chk.errors + ((diff) ? 1 : 0);
+
+        // Throughput, each engine over fresh copies of the picture
+        for (int ee = 0; ee < 3; ee++) {
+            memset(&dbp, 0, sizeof(dbp));
+            gg_deblock_open(&dbp, (ee) ? GG_DEBLOCK_FAST : GG_DEBLOCK_RING, ee == 2);
+            for (int ii = 0; ii < iterations; ii++) {
+                memcpy(pic.y, in.y, pic_size(fr));
+                secs[ee] += replay_frame(&dbp, fr, &pic, NULL);
+            }
+            gg_deblock_free(&dbp);
+        }
+        num_mb += (long long)fr->num_mb * iterations;
+        free(in.y);
+        free(ring.y);
+        free(pic.y);
+    }
+
+    for (int ee = 0; ee < 3; ee++)
+        printf("%-16s %8.3f s %10.0f MB/s\n", engine_name[ee], secs[ee], (secs[ee] > 0) ? num_mb / secs[ee] : 0.0);
+    if (errors) {
+        printf("ERROR: test failed with %d errors\n", errors);
+        return(1);
+    }
+    printf("PASS: test passed without failures\n");
+    return(0);
+}
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+#include "gg_alloc.h"
+
+#define GG_MPOL_PREFERRED 1 // linux/mempolicy.h MPOL_PREFERRED, falls back to other nodes when full
+
+// Block header, kept in the cache line ahead of the returned pointer
+typedef struct _AllocHdr {
+	void* base; // start of the underlying allocation
+	size_t len; // mapped length, 0 if from the heap
+	size_t size; // usable bytes
+	int huge; // 0-small pages, 1-transparent huge pages, 2-hugetlb
+} AllocHdr;
+
+// Map len bytes, untouched, with huge pages if asked for
+static unsigned char* alloc_map(size_t len, int huge_flag, int* huge)
+{
+	unsigned char* base = NULL;
+#ifndef _WIN32
+	*huge = 0;
+#ifdef MAP_HUGETLB
+	if (huge_flag) {
+		base = (unsigned char*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (base != MAP_FAILED) {
+			*huge = 2;
+			return(base);
+		}
+	}
+#endif
+	base = (unsigned char*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return(NULL);
+#ifdef MADV_HUGEPAGE
+	if (huge_flag && !madvise(base, len, MADV_HUGEPAGE)) // no reserved huge pages, ask for transparent ones
+		*huge = 1;
+#endif
+#endif
+	return(base);
+}
+
+static void* alloc_block(size_t size, int huge_flag, int node)
+{
+	unsigned char* base = NULL;
+	size_t len = 0;
+	int huge = 0;
+
+	size += GG_ALLOC_ALIGN;
+#ifdef _WIN32
+	// Large pages need SeLockMemoryPrivilege on Windows, use the heap
+	(void)huge_flag;
+	(void)node;
+	base = (unsigned char*)_aligned_malloc(size, GG_ALLOC_ALIGN);
+#else
+	if ((huge_flag && size >= GG_ALLOC_HUGE_SIZE) || node >= 0) {
+		len = GG_ALIGN(size, (huge_flag && size >= GG_ALLOC_HUGE_SIZE) ? GG_ALLOC_HUGE_SIZE : (size_t)sysconf(_SC_PAGESIZE));
+		base = alloc_map(len, huge_flag && size >= GG_ALLOC_HUGE_SIZE, &huge);
+#ifdef __linux__
+		if (base && node >= 0) { // bind before the first touch places the pages
+			unsigned long mask[4] = { 0 };
+			if (node < 256) {
+				mask[node >> 6] = 1UL << (node & 63);
+				syscall(SYS_mbind, base, len, GG_MPOL_PREFERRED, mask, 257, 0);
+			}
+		}
+#endif
+	}
+	if (!base) {
+		len = 0;
+		huge = 0;
+		if (posix_memalign((void**)&base, GG_ALLOC_ALIGN, size))
+			base = NULL;
+	}
+#endif
+	if (!base)
+		return(NULL);
+	((AllocHdr*)base)->base = base;
+	((AllocHdr*)base)->len = len;
+	((AllocHdr*)base)->size = size - GG_ALLOC_ALIGN;
+	((AllocHdr*)base)->huge = huge;
+	return(base + GG_ALLOC_ALIGN);
+}
+
+void* gg_alloc(size_t size, int huge_flag)
+{
+	return(alloc_block(size, huge_flag, -1));
+}
+
+void gg_free(void* p)
+{
+	AllocHdr* hdr;
+	if (!p)
+		return;
+	hdr = (AllocHdr*)((unsigned char*)p - GG_ALLOC_ALIGN);
+#ifdef _WIN32
+	_aligned_free(hdr->base);
+#else
+	if (hdr->len)
+		munmap(hdr->base, hdr->len);
+	else
+		free(hdr->base);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Memory pool
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// node -1 binds to the node of the calling thread, -2 leaves placement to the kernel
+void gg_pool_init(MemPool* pool, int huge_flag, int node)
+{
+	memset(pool, 0, sizeof(MemPool));
+	pool->huge_flag = huge_flag;
+	pool->node = -1;
+	pool->perf_fd = -1;
+#ifdef __linux__
+	if (node == -1) {
+		unsigned int cpu, cur;
+		if (!syscall(SYS_getcpu, &cpu, &cur, NULL))
+			node = (int)cur;
+	}
+	pool->node = (node >= 0) ? node : -1;
+
+	// dTLB load misses of this thread, user space only
+	{
+		struct perf_event_attr pe;
+		memset(&pe, 0, sizeof(pe));
+		pe.type = PERF_TYPE_HW_CACHE;
+		pe.size = sizeof(pe);
+		pe.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		pe.exclude_kernel = 1;
+		pe.exclude_hv = 1;
+		pool->perf_fd = (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+		if (pool->perf_fd >= 0)
+			ioctl(pool->perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#else
+	(void)node;
+#endif
+}
+
+void* gg_pool_alloc(MemPool* pool, size_t size)
+{
+	void* p;
+	AllocHdr* hdr;
+	if (pool->num_blocks == GG_POOL_MAX_BLOCKS) {
+		printf("ERROR: memory pool full\n");
+		return(NULL);
+	}
+	p = alloc_block(size, pool->huge_flag, pool->node);
+	if (!p)
+		return(NULL);
+	hdr = (AllocHdr*)((unsigned char*)p - GG_ALLOC_ALIGN);
+	pool->block[pool->num_blocks++] = p;
+	pool->bytes += hdr->size;
+	if (hdr->huge)
+		pool->huge_bytes += hdr->size;
+	return(p);
+}
+
+void gg_pool_free(MemPool* pool, void* p)
+{
+	for (int ii = 0; ii < pool->num_blocks; ii++) {
+		if (pool->block[ii] == p) {
+			AllocHdr* hdr = (AllocHdr*)((unsigned char*)p - GG_ALLOC_ALIGN);
+			pool->bytes -= hdr->size;
+			if (hdr->huge)
+				pool->huge_bytes -= hdr->size;
+			pool->block[ii] = pool->block[--pool->num_blocks];
+			gg_free(p);
+			return;
+		}
+	}
+}
+
+void gg_pool_report(MemPool* pool)
+{
+	long long local = 0, remote = 0, absent = 0;
+	long long tlb_miss = -1;
+
+#ifdef __linux__
+	// Sample up to 1024 pages per block for the node they are on
+	long page = sysconf(_SC_PAGESIZE);
+	void* pages[1024];
+	int status[1024];
+	for (int bb = 0; bb < pool->num_blocks; bb++) {
+		AllocHdr* hdr = (AllocHdr*)((unsigned char*)pool->block[bb] - GG_ALLOC_ALIGN);
+		size_t num = (hdr->size + page - 1) / page;
+		size_t step = (num + 1023) / 1024;
+		int count = 0;
+		for (size_t pp = 0; pp < num && count < 1024; pp += step)
+			pages[count++] = (unsigned char*)pool->block[bb] + pp * page;
+		if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0))
+			continue;
+		for (int ii = 0; ii < count; ii++) {
+			if (status[ii] < 0)
+				absent++;
+			else if (pool->node < 0 || status[ii] == pool->node)
+				local++;
+			else
+				remote++;
+		}
+	}
+	if (pool->perf_fd >= 0 && read(pool->perf_fd, &tlb_miss, sizeof(tlb_miss)) != sizeof(tlb_miss))
+		tlb_miss = -1;
+#endif
+	printf("Memory pool: %d blocks %.1f MB, %.1f MB on huge pages, node %d, sampled pages local %lld remote %lld untouched %lld",
+		pool->num_blocks, pool->bytes / 1048576.0, pool->huge_bytes / 1048576.0, pool->node, local, remote, absent);
+	if (tlb_miss >= 0)
+		printf(", dTLB load misses %lld\n", tlb_miss);
+	else
+		printf(", dTLB counter n/a\n");
+}
+
+// Release anything still allocated
+void gg_pool_close(MemPool* pool)
+{
+	while (pool->num_blocks)
+		gg_pool_free(pool, pool->block[0]);
+#ifdef __linux__
+	if (pool->perf_fd >= 0)
+		close(pool->perf_fd);
+#endif
+	pool->perf_fd = -1;
+}
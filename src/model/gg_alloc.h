@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+
+// Aligned frame store allocation
+// Blocks are 64 byte (cache line) aligned. With huge_flag, blocks of 2 MB or more are backed by
+// huge pages: explicit MAP_HUGETLB pages if the system has them reserved, else transparent huge pages.
+
+#define GG_ALLOC_ALIGN 64
+#define GG_ALLOC_HUGE_SIZE (2 << 20)
+#define GG_ALIGN(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+void* gg_alloc(size_t size, int huge_flag);
+void gg_free(void* p);
+
+// Memory pool of one encoder instance (frame stores and per-mb scratch)
+// Blocks are mapped untouched and bound to a NUMA node before first use (Linux mbind),
+// by default the node of the thread that creates the pool, i.e. the one encoding the stream.
+// The report gives huge page coverage, where the pages actually landed (move_pages) and
+// the dTLB load misses of the owning thread (perf events) while the pool was live.
+
+#define GG_POOL_MAX_BLOCKS 32
+
+typedef struct _MemPool {
+	int huge_flag;
+	int node; // bound NUMA node, -1 if not bound
+	void* block[GG_POOL_MAX_BLOCKS];
+	int num_blocks;
+
+	// Stats
+	long long bytes;
+	long long huge_bytes; // in blocks on huge pages (explicit or transparent)
+	int perf_fd; // dTLB load miss counter, -1 if not available
+} MemPool;
+
+void gg_pool_init(MemPool* pool, int huge_flag, int node);
+void* gg_pool_alloc(MemPool* pool, size_t size);
+void gg_pool_free(MemPool* pool, void* p);
+void gg_pool_report(MemPool* pool);
+void gg_pool_close(MemPool* pool);
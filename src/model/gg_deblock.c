@@ -1,20 +1,27 @@
 #define _CRT_SECURE_NO_WARNINGS 1
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GG_DEBLOCK_SSE2 1
+#endif
 #include "gg_process.h"
 #include "gg_deblock.h"
 
 
 FILE* db_fp;
+//#define DEBLOCK_SELF_TEST
 //#define LOG_DEBLOCK
 #ifdef LOG_DEBLOCK
 #define LogOutput( b, dir ) { fprintf(db_fp, "2\n%x ", (dir)); for (int ii = 0; ii < 16; ii++) fprintf(db_fp, "%02x ", (b)->d[ii] & 0xff); fprintf(db_fp, "\n"); }
-#define LogInput( b, cidx, bidx ) { fprintf(db_fp, "3\n%x %x %x ", (cidx), (bidx), (b)->nz); for (int ii = 0; ii < 16; ii++) fprintf(db_fp, "%02x ", (b)->d[ii] & 0xff); fprintf(db_fp, "\n"); }
+#define LogInput( b, cidx, bidx ) { fprintf(db_fp, "3\n%x %x %x ", (cidx), (bidx), (((cidx) == 0) ? num_coeff_y[bidx] : ((cidx) == 2) ? num_coeff_cb[bidx] : num_coeff_cr[bidx]) ? 1 : 0); for (int ii = 0; ii < 16; ii++) fprintf(db_fp, "%02x ", (b)->d[ii] & 0xff); fprintf(db_fp, "\n"); }
 #define LogStep() { fprintf(db_fp, "4\n"); } 
-#define LogMblock( ) { fprintf(db_fp, "1\n%x %x %x %x %x %x %x\n", mbx, mby, qp, mb_type, refidx, 0, 0); }
+#define LogMblock( ) { fprintf(db_fp, "1\n%x %x %x %x %x %x %x\n", mbx, mby, qp, mb_type, refidx, mvx & 0xffff, mvy & 0xffff); }
 #define LogFrame() { db_fp = fopen("deblock_test.txt", "w"); fprintf(db_fp, "0\n%x %x %x %x %x\n", disable_deblock_filter_idc, filterOffsetA, filterOffsetB, mb_width-1, mb_height-1); }
 #define LogClose() { fclose(db_fp); }
 #else
-#define LogOutput( b, dir ) {}
+#define LogOutput( b, dir ) { if (dbp->log_out) dbp->log_out(dbp->log_arg, (b), (dir)); }
 #define LogInput( b, cidx, bidx ) {}
 #define LogStep() {} 
 #define LogMblock( ) {}
@@ -22,10 +29,34 @@ FILE* db_fp;
 #define LogClose() {}
 #endif
 
+#ifdef DEBLOCK_SELF_TEST
+static char* test_buf; // picture filtered by the other engine
+static size_t test_size;
+static int test_frames;
+#endif
+
 
 
 // Init frame deblocking structure
-void gg_deblock_init(DeblockCtx* dbp, int disable_deblock_filter_idc, int filterOffsetA, int filterOffsetB, int mb_width, int mb_height ) {
+void gg_deblock_init(DeblockCtx* dbp, int disable_deblock_filter_idc, int filterOffsetA, int filterOffsetB, int mb_width, int mb_height, int stride_y, int stride_c ) {
+
+	// Row lagged thread: rows of older pictures are finished first, so only the previous picture (the
+	// new ref) can still be in flight and a released buffer is never reused under the thread.
+	// A parameter change or a larger picture waits for the thread to go idle.
+	dbp->first_mb = 0;
+	if (dbp->async_flag) {
+		int idle = (disable_deblock_filter_idc != dbp->disable_deblock_filter_idc || filterOffsetA != dbp->filterOffsetA || filterOffsetB != dbp->filterOffsetB ||
+			mb_width != dbp->mb_width || mb_height != dbp->mb_height || stride_y != dbp->stride_y || stride_c != dbp->stride_c);
+		gg_mutex_lock(&dbp->lock);
+		while (dbp->q_len && (idle || dbp->queue[dbp->q_head].y != dbp->queue[(dbp->q_head + dbp->q_len - 1) % GG_DEBLOCK_QUEUE].y)) {
+			dbp->num_waits++;
+			gg_cond_wait(&dbp->cond, &dbp->lock);
+		}
+		idle = !dbp->q_len;
+		gg_mutex_unlock(&dbp->lock);
+		if (!idle) // same params, the thread still owns the state below
+			return;
+	}
 
 	// save slice params
 	dbp->disable_deblock_filter_idc = disable_deblock_filter_idc;
@@ -33,13 +64,26 @@ void gg_deblock_init(DeblockCtx* dbp, int disable_deblock_filter_idc, int filter
 	dbp->filterOffsetB = filterOffsetB;
 	dbp->mb_width = mb_width;
 	dbp->mb_height = mb_height;
-
-	// init buffers
-	for (int ii = 0; ii < 1024; ii++) { // mark above row out of pic
-		dbp->abv[ii].oop = 1;
-	}
-	for (int ii = 0; ii < 64; ii++) {
-		dbp->ring[ii].oop = 1; // mark buffer as out of pic
+	dbp->stride_y = stride_y;
+	dbp->stride_c = stride_c;
+
+	// init buffers, above row sized to the picture width (kept across frames)
+	// Out of picture neighbours are never read, the left and top edges are only filtered inside the picture
+	if (dbp->mbi_size < mb_width) {
+		int ok;
+		free(dbp->abv);
+		free(dbp->mbi);
+		dbp->abv = (BlkPix*)malloc(sizeof(BlkPix) * mb_width * 8);
+		dbp->mbi = (MbInfo*)malloc(sizeof(MbInfo) * mb_width);
+		ok = dbp->abv && dbp->mbi;
+		for (int ii = 0; ii < GG_DEBLOCK_QUEUE; ii++) {
+			free(dbp->queue[ii].mb);
+			dbp->queue[ii].mb = (MbInfo*)malloc(sizeof(MbInfo) * mb_width);
+			ok = ok && dbp->queue[ii].mb;
+		}
+		dbp->mbi_size = (ok) ? mb_width : 0;
+		if (!dbp->mbi_size)
+			printf("ERROR: out of memory for deblock row buffer\n");
 	}
 	// init pointers
 	dbp->mbx = 0;
@@ -48,28 +92,86 @@ void gg_deblock_init(DeblockCtx* dbp, int disable_deblock_filter_idc, int filter
 	LogFrame();
 }
 
-void gg_deblock_init_row(DeblockCtx* dbp)
+// Start of a new slice, first_mb is the raster mb address of the first slice macroblock
+// Used to suppress filtering across slice boundaries when disable_deblock_filter_idc == 2
+void gg_deblock_init_slice(DeblockCtx* dbp, int first_mb)
 {
-	if (dbp->disable_deblock_filter_idc == 2) {
-		for (int ii = 0; ii < 1024; ii++) { // mark above row out of pic
-			dbp->abv[ii].oop = 1;
-		}
-	}
+	dbp->first_mb = first_mb;
 }
 
 void gg_deblock_close() {
 	LogClose();
 }
 
-void deblock_c4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInfo* p_blk, int* bS)
+void gg_deblock_free(DeblockCtx* dbp) {
+	if (dbp->async_flag) {
+		gg_mutex_lock(&dbp->lock);
+		dbp->stop = 1;
+		gg_cond_broadcast(&dbp->cond);
+		gg_mutex_unlock(&dbp->lock);
+		gg_thread_join(dbp->thread);
+		gg_cond_destroy(&dbp->cond);
+		gg_mutex_destroy(&dbp->lock);
+		dbp->async_flag = 0;
+		printf("Deblock: encoder waited on the deblock thread %d times\n", dbp->num_waits);
+	}
+	if (dbp->num_mb)
+		printf("Deblock: %lld of %lld macroblocks bypassed, bS 0 on every edge\n", dbp->num_bypass, dbp->num_mb);
+#ifdef DEBLOCK_SELF_TEST
+	printf("Deblock self test: %d frames compared, fast and ring engines\n", test_frames);
+	free(test_buf);
+	test_buf = NULL;
+	test_size = 0;
+#endif
+	free(dbp->abv);
+	free(dbp->mbi);
+	dbp->abv = NULL;
+	dbp->mbi = NULL;
+	for (int ii = 0; ii < GG_DEBLOCK_QUEUE; ii++) {
+		free(dbp->queue[ii].mb);
+		dbp->queue[ii].mb = NULL;
+	}
+	dbp->mbi_size = 0;
+}
+
+#define MB_TYPE( m ) ((m)->type & 3)
+#define MB_REF( m ) (((m)->type >> 2) & 3)
+// Different reference or a mv component 4 or more quarter samples apart (8.7.2.1)
+#define MB_MOTION_DIFF( p, q ) (MB_REF(p) != MB_REF(q) || abs((p)->mvx - (q)->mvx) >= 4 || abs((p)->mvy - (q)->mvy) >= 4)
+#define MB_LFIL 0x10 // left mb edge is filtered
+#define MB_TFIL 0x20 // top mb edge is filtered
+
+// bS of the edge between 4x4 block p_blk of mb p and q_blk of mb q (8.7.2.1), one mv per macroblock
+static int edge_bs(const MbInfo* p, int p_blk, const MbInfo* q, int q_blk, int mb_edge)
+{
+	if (MB_TYPE(p) == GG_MBTYPE_INTRA || MB_TYPE(q) == GG_MBTYPE_INTRA)
+		return((mb_edge) ? 4 : 3);
+	if (((p->nz >> p_blk) & 1) || ((q->nz >> q_blk) & 1))
+		return(2);
+	if (MB_MOTION_DIFF(p, q))
+		return(1);
+	return(0);
+}
+
+// Macroblock on the p side of the edge at block (blk_x, blk_y) of the current mb
+static const MbInfo* edge_p_mb(DeblockCtx* dbp, int blk_x, int blk_y, int vert_flag)
+{
+	if (!vert_flag && blk_x == 0)
+		return(&dbp->mbi[dbp->mbx - 1]);
+	if (vert_flag && blk_y == 0)
+		return(&dbp->mbi[dbp->mbx]);
+	return(&dbp->cur);
+}
+
+void deblock_c4(DeblockCtx* dbp, int bidx, int vert_flag, BlkPix* q_blk, BlkPix* p_blk, int* bS)
 {
 	int qpp, qpq, qpavg;
 	int indexA, indexB;
 	int alpha, beta;
 	int filterSamplesFlag;
 
-	int* p0, * p1, * p2, * p3;
-	int* q0, * q1, * q2, * q3;
+	unsigned char* p0, * p1, * p3;
+	unsigned char* q0, * q1, * q3;
 	int p_nxt[4], q_nxt[4];
 	int tc, tc0;
 	int delta;
@@ -82,20 +184,16 @@ void deblock_c4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 	//if (dbp->disable_deblock_filter_idc == 1)
 	//	return;
 
-	// Check if prev is out of picture
-	if (p_blk->oop)
-		return;
-
 	// Derive block QPz's to be used for filtering
-	qpp = (p_blk->mb_type == GG_MBTYPE_IPCM) ? qpc_table[0] : qpc_table[p_blk->qp];
-	qpq = (q_blk->mb_type == GG_MBTYPE_IPCM) ? qpc_table[0] : qpc_table[q_blk->qp];
+	qpp = gg_quant.qpc[edge_p_mb(dbp, blk_x, blk_y, vert_flag)->qp];
+	qpq = gg_quant.qpc[dbp->cur.qp];
 	qpavg = (qpp + qpq + 1) >> 1;  // eqn (8-217)
 
 	// Determine edge thresholds
 	indexA = CLIP3(0, 51, qpavg + dbp->filterOffsetA);
 	indexB = CLIP3(0, 51, qpavg + dbp->filterOffsetB);
-	alpha = alpha_table[indexA];
-	beta = beta_table[indexB];
+	alpha = gg_dbk.alpha[indexA];
+	beta = gg_dbk.beta[indexB];
 
 	// loop and filter along an edge
 	for (int ii = 0; ii < 4; ii++) {
@@ -103,21 +201,17 @@ void deblock_c4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 		if (!vert_flag) { // Horizontal Filter  
 			p0 = &p_blk->d[3 + ii * 4];
 			p1 = &p_blk->d[2 + ii * 4];
-			p2 = &p_blk->d[1 + ii * 4];
 			p3 = &p_blk->d[0 + ii * 4];
 			q0 = &q_blk->d[0 + ii * 4];
 			q1 = &q_blk->d[1 + ii * 4];
-			q2 = &q_blk->d[2 + ii * 4];
 			q3 = &q_blk->d[3 + ii * 4];
 		}
 		else { // Vertical filter
 			p0 = &p_blk->d[12 + ii];
 			p1 = &p_blk->d[8 + ii];
-			p2 = &p_blk->d[4 + ii];
 			p3 = &p_blk->d[0 + ii];
 			q0 = &q_blk->d[0 + ii];
 			q1 = &q_blk->d[4 + ii];
-			q2 = &q_blk->d[8 + ii];
 			q3 = &q_blk->d[12 + ii];
 		}
 		// Default pels
@@ -127,17 +221,12 @@ void deblock_c4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 		// Filtering Process
 		filterSamplesFlag = (bS[ii >> 1] != 0 && ABS(*p0 - *q0) < alpha && ABS(*q1 - *q0) < beta && ABS(*p1 - *p0) < beta) ? 1 : 0; // eqn (8-224)
 		if (filterSamplesFlag && bS[ii >> 1] == 4) { // max filter strength - only for intra mb edges
-			// P, Bs==4
-			if ((ABS(*p2 - *p0) < beta && ABS(*p0 - *q0) < ((alpha >> 2) + 2))) {
-				p_nxt[0] = (2 * *p1 + *p0 + *q1 + 2) >> 2;
-			}
-			// Q, Bs==4
-			if ((ABS(*q2 - *q0) < beta && ABS(*p0 - *q0) < ((alpha >> 2) + 2))) {
-				q_nxt[0] = (2 * *p1 + *q0 + *p1 + 2) >> 2;
-			}
+			// P, Q Bs==4, chroma always uses the 3 tap form
+			p_nxt[0] = (2 * *p1 + *p0 + *q1 + 2) >> 2;
+			q_nxt[0] = (2 * *q1 + *q0 + *p1 + 2) >> 2;
 		}
 		else if (filterSamplesFlag && bS[ii>>1] ) { // Bs == 1, 2, or 3 
-			tc0 = tc0_table[bS[ii >> 1] - 1][indexA];
+			tc0 = gg_dbk.tc0[bS[ii >> 1] - 1][indexA];
 			tc = tc0 + 1;
 			delta = CLIP3(-tc, tc, ((((*q0 - *p0) << 2) + (*p1 - *q1) + 4) >> 3));
 			p_nxt[0] = CLIP1(*p0 + delta);
@@ -149,14 +238,14 @@ void deblock_c4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 	}
 }
 
-void deblock_y4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInfo* p_blk, int* bS)
+void deblock_y4(DeblockCtx* dbp, int bidx, int vert_flag, BlkPix* q_blk, BlkPix* p_blk, int* bS)
 {
 	int qpp, qpq, qpavg;
 	int indexA, indexB;
 	int alpha, beta;
 	int filterSamplesFlag;
-	int* p0, * p1, * p2, * p3;
-	int* q0, * q1, * q2, * q3;
+	unsigned char* p0, * p1, * p2, * p3;
+	unsigned char* q0, * q1, * q2, * q3;
 	int p_nxt[4], q_nxt[4];
 	int tc, tc0;
 	int delta;
@@ -164,39 +253,28 @@ void deblock_y4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 	// Flags
 	int blk_x = ((bidx & 1) ? 1 : 0) + ((bidx & 4) ? 2 : 0);
 	int blk_y = ((bidx & 2) ? 1 : 0) + ((bidx & 8) ? 2 : 0);
+	int mb_edge = (vert_flag) ? (blk_y == 0) : (blk_x == 0);
+	const MbInfo* p_mb = edge_p_mb(dbp, blk_x, blk_y, vert_flag);
+	int q_bit = blk_y * 4 + blk_x;
+	int p_bit = (vert_flag) ? (q_bit + ((mb_edge) ? 12 : -4)) : (q_bit + ((mb_edge) ? 3 : -1));
 
 	// Check if deblocking is disabled and exit
 	//if (dbp->disable_deblock_filter_idc == 1)
 	//	return;
 
-	// Check if prev is out of picture
-	if (p_blk->oop)
-		return;
-
 	// Derive block QPz's to be used for filtering
-	qpp = (p_blk->mb_type == GG_MBTYPE_IPCM) ? 0 : p_blk->qp;
-	qpq = (q_blk->mb_type == GG_MBTYPE_IPCM) ? 0 : q_blk->qp;
+	qpp = p_mb->qp;
+	qpq = dbp->cur.qp;
 	qpavg = (qpp + qpq + 1) >> 1;  // eqn (8-217)
 
 	// Derive Bs
-	if (p_blk->mb_type == GG_MBTYPE_INTRA || q_blk->mb_type == GG_MBTYPE_INTRA) {
-		*bS = (blk_x == 0 && !vert_flag || blk_y == 0 && vert_flag) ? 4 : 3;
-	}
-	else if (p_blk->nz || q_blk->nz) {
-		*bS = 2;
-	}
-	else if (p_blk->refidx != q_blk->refidx || ABS(p_blk->mvx - q_blk->mvx) >= 4 || ABS(p_blk->mvy - q_blk->mvy) >= 4) {
-		*bS = 1;
-	}
-	else {
-		*bS = 0;
-	}
+	*bS = edge_bs(p_mb, p_bit, &dbp->cur, q_bit, mb_edge);
 
 	// Determine edge thresholds
 	indexA = CLIP3(0, 51, qpavg + dbp->filterOffsetA);
 	indexB = CLIP3(0, 51, qpavg + dbp->filterOffsetB);
-	alpha = alpha_table[indexA];
-	beta = beta_table[indexB];
+	alpha = gg_dbk.alpha[indexA];
+	beta = gg_dbk.beta[indexB];
 
 	// loop and filter along an edge
 	for (int ii = 0; ii < 4; ii++ ) {
@@ -238,15 +316,21 @@ void deblock_y4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 				p_nxt[1] = (*p2 + *p1 + *p0 + *q0 + 2) >> 2;
 				p_nxt[2] = (2 * *p3 + 3 * *p2 + *p1 + *p0 + *q0 + 4) >> 3;
 			}
+			else {
+				p_nxt[0] = (2 * *p1 + *p0 + *q1 + 2) >> 2;
+			}
 			// Q, Bs==4
 			if (ABS(*q2 - *q0) < beta && ABS(*p0 - *q0) < ((alpha >> 2) + 2)) {
 				q_nxt[0] = (*p1 + 2 * *p0 + 2 * *q0 + 2 * *q1 + *q2 + 4) >> 3;
 				q_nxt[1] = (*p0 + *q0 + *q1 + *q2 + 2) >> 2;
 				q_nxt[2] = (2 * *q3 + 3 * *q2 + *q1 + *q0 + *p0 + 4) >> 3;
 			}
+			else {
+				q_nxt[0] = (2 * *q1 + *q0 + *p1 + 2) >> 2;
+			}
 		}
 		else if (filterSamplesFlag && *bS) { // Bs == 1, 2, or 3 
-			tc0 = tc0_table[*bS - 1][indexA];
+			tc0 = gg_dbk.tc0[*bS - 1][indexA];
 			tc = tc0 + ((ABS(*p2 - *p0) < beta) ? 1 : 0) + ((ABS(*q2 - *q0) < beta) ? 1 : 0);
 			delta = CLIP3(-tc, tc, ((((*q0 - *p0) << 2) + (*p1 - *q1) + 4) >> 3));
 			p_nxt[0] = CLIP1(*p0 + delta);
@@ -270,18 +354,19 @@ void deblock_y4(DeblockCtx* dbp, int bidx, int vert_flag, BlkInfo* q_blk, BlkInf
 
 
 
-#define WriteBlkY(r, x, y, b) { for (int py = 0; py < 4; py++) for (int px = 0; px < 4; px++) \
-				(r)[(mby * 16 + (y) * 4 + py) * dbp->mb_width * 16 + mbx * 16 + (x) * 4 + px] = 0xff & (b)->d[py * 4 + px];}
-#define WriteBlkC(r, x, y, b) { for (int py = 0; py < 4; py++) for (int px = 0; px < 4; px++) \
-				(r)[(mby * 8 + (y) * 4 + py) * dbp->mb_width * 8 + mbx * 8 + (x) * 4 + px] = 0xff & (b)->d[py * 4 + px];}
+#define WriteBlkY(r, x, y, b) { for (int py = 0; py < 4; py++) \
+				memcpy(&(r)[(mby * 16 + (y) * 4 + py) * dbp->stride_y + mbx * 16 + (x) * 4], &(b)->d[py * 4], 4);}
+#define WriteBlkC(r, x, y, b) { for (int py = 0; py < 4; py++) \
+				memcpy(&(r)[(mby * 8 + (y) * 4 + py) * dbp->stride_c + mbx * 8 + (x) * 4], &(b)->d[py * 4], 4);}
 #define CopyBlk( dest, src ) {  *dest = *src; }
 
-#define AlePtr( x )  (&(dbp->abv[(mbx*8+(x)+1024-8)&0x3ff]))
-#define AbvPtr( x )  (&(dbp->abv[(mbx*8+(x)+1024)&0x3ff]))
+#define AlePtr( x )  (&(dbp->abv[mbx*8+(x)-8])) // only used when mbx > 0
+#define AbvPtr( x )  (&(dbp->abv[mbx*8+(x)]))
 #define LefPtr( x )  (&(dbp->ring[((x)+64-24+dbp->ring_idx)&0x3f]))
 #define BlkPtr( x )  (&(dbp->ring[((x)+64+dbp->ring_idx)&0x3f]))
 
-void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon_cb, char *recon_cr, int *num_coeff_y, int* num_coeff_cb, int *num_coeff_cr, int qp, int refidx, int mb_type)
+// Hardware order model, filters 4x4 blocks through the ring as the RTL does
+static void deblock_mb_ring(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon_cb, char *recon_cr, int *num_coeff_y, int* num_coeff_cb, int *num_coeff_cr, int qp, int refidx, int mvx, int mvy, int mb_type)
 {
 	int bidx;
 	int blkx, blky;
@@ -289,38 +374,25 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	LogMblock();
 
-	// No function if deblocking disabled
-	if (dbp->disable_deblock_filter_idc == 1)
-		return;
-
 	// advance ring pointer by 24 mod 64
 	dbp->ring_idx = (dbp->ring_idx + 24) & 0x3F;
 
 	//if (mbx == 6 && mby == 4)
 	//	printf("Z");
 
-	// load macroblock's block & info into ring in decode order
+	// load macroblock's blocks into ring in decode order
 	for (bidx = 0; bidx < 24; bidx++) {
 		blkx = ((bidx & 1) ? 1 : 0) + ((bidx < 16) ? ((bidx & 4) ? 2 : 0) : 0);
 		blky = ((bidx & 2) ? 1 : 0) + ((bidx < 16) ? ((bidx & 8) ? 2 : 0) : 0);
-		BlkPtr(bidx)->mb_type = mb_type;
-		BlkPtr(bidx)->qp = qp;
-		BlkPtr(bidx)->refidx = refidx;
-		BlkPtr(bidx)->mvx = 0;
-		BlkPtr(bidx)->mvy = 0;
-		BlkPtr(bidx)->oop = 0;
-		BlkPtr(bidx)->nz = ( bidx < 16 ) ? ((num_coeff_y[bidx]) ? 1 : 0) : ( bidx < 20 ) ? ((num_coeff_cb[bidx - 16]) ? 1 : 0) : ((num_coeff_cr[bidx - 20]) ? 1 : 0);
 		for (int py = 0; py < 4; py++) {
-			for (int px = 0; px < 4; px++) {
-				if (bidx < 16) { // y
-					BlkPtr(bidx)->d[py * 4 + px] = 0xff & recon_y[mbx * 16 + blkx * 4 + px + (mby * 16 + blky * 4 + py) * dbp->mb_width * 16];
-				}
-				else if (bidx < 20) { // cb
-					BlkPtr(bidx)->d[py * 4 + px] = 0xff & recon_cb[mbx * 8 + blkx * 4 + px + (mby * 8 + blky * 4 + py) * dbp->mb_width * 8];
-				}
-				else { // cr
-					BlkPtr(bidx)->d[py * 4 + px] = 0xff & recon_cr[mbx * 8 + blkx * 4 + px + (mby * 8 + blky * 4 + py) * dbp->mb_width * 8];
-				}
+			if (bidx < 16) { // y
+				memcpy(&BlkPtr(bidx)->d[py * 4], &recon_y[mbx * 16 + blkx * 4 + (mby * 16 + blky * 4 + py) * dbp->stride_y], 4);
+			}
+			else if (bidx < 20) { // cb
+				memcpy(&BlkPtr(bidx)->d[py * 4], &recon_cb[mbx * 8 + blkx * 4 + (mby * 8 + blky * 4 + py) * dbp->stride_c], 4);
+			}
+			else { // cr
+				memcpy(&BlkPtr(bidx)->d[py * 4], &recon_cr[mbx * 8 + blkx * 4 + (mby * 8 + blky * 4 + py) * dbp->stride_c], 4);
 			}
 		}
 	}
@@ -349,6 +421,8 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 	int nlbp = (mby == dbp->mb_height - 1 && mbx) ? 1 : 0; // Bottom pic edge, but not left corner
 	int brcn = (mbx == dbp->mb_width - 1 && mby == dbp->mb_height - 1) ? 1 : 0; // bottom right corner
 	int alwy = 1; // always
+	int lfil = (nlef && (dbp->disable_deblock_filter_idc != 2 || mby * dbp->mb_width + mbx - 1 >= dbp->first_mb)) ? 1 : 0; // filter left mb edge, idc 2 stops at slice edges
+	int tfil = (ntop && (dbp->disable_deblock_filter_idc != 2 || (mby - 1) * dbp->mb_width + mbx >= dbp->first_mb)) ? 1 : 0; // filter top mb edge, idc 2 stops at slice edges
 
 	//////////////////////////////////////////////////////////////
 	//
@@ -360,7 +434,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 0
 	LogInput(BlkPtr(0), 0, 0);
-	if (nlef) deblock_y4(dbp, 0, 0, BlkPtr(0), LefPtr(5), &bSh[0]);
+	if (lfil) deblock_y4(dbp, 0, 0, BlkPtr(0), LefPtr(5), &bSh[0]);
 	if (nlef) WriteBlkY(recon_y, -1, 0, LefPtr(5));
 	if (nlef) LogOutput( LefPtr(5), 2 );
 	LogStep();
@@ -368,14 +442,14 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 	// 1
 	LogInput(BlkPtr(1), 0, 1);
 	if (alwy) deblock_y4(dbp, 1, 0, BlkPtr(1), BlkPtr(0), &bSh[4]);
-	if (ntop) deblock_y4(dbp, 0, 1, BlkPtr(0), AbvPtr(0), &bSv[0]);
+	if (tfil) deblock_y4(dbp, 0, 1, BlkPtr(0), AbvPtr(0), &bSv[0]);
 	if (ntop) WriteBlkY(recon_y, 0, -1, AbvPtr(0));
 	if (ntop) LogOutput( AbvPtr(0), 0 );
 	LogStep();
 
 	// 2
 	LogInput(BlkPtr(2), 0, 2);
-	if (nlef) deblock_y4(dbp, 2, 0, BlkPtr(2), LefPtr(7), &bSh[1]);
+	if (lfil) deblock_y4(dbp, 2, 0, BlkPtr(2), LefPtr(7), &bSh[1]);
 	if (nlef) WriteBlkY(recon_y, -1, 1, LefPtr(7));
 	if (nlef) LogOutput( LefPtr(7), 2);
 	LogStep();
@@ -391,7 +465,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 	// 4
 	LogInput(BlkPtr(4), 0, 4);
 	if (alwy) deblock_y4(dbp, 4, 0, BlkPtr(4), BlkPtr(1), &bSh[8]);
-	if (ntop) deblock_y4(dbp, 1, 1, BlkPtr(1), AbvPtr(1), &bSv[1]);
+	if (tfil) deblock_y4(dbp, 1, 1, BlkPtr(1), AbvPtr(1), &bSv[1]);
 	if (ntop) WriteBlkY(recon_y, 1, -1, AbvPtr(1));
 	if (ntop) LogOutput( AbvPtr(1), 0);
 	LogStep();
@@ -399,8 +473,8 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 	// 5
 	LogInput(BlkPtr(5), 0, 5);
 	if (alwy) deblock_y4(dbp, 5, 0, BlkPtr(5), BlkPtr(4), &bSh[12]);
-	if (ntop) deblock_y4(dbp, 4, 1, BlkPtr(4), AbvPtr(2), &bSv[2]);
-	if (ntop) deblock_y4(dbp, 5, 1, BlkPtr(5), AbvPtr(3), &bSv[3]);
+	if (tfil) deblock_y4(dbp, 4, 1, BlkPtr(4), AbvPtr(2), &bSv[2]);
+	if (tfil) deblock_y4(dbp, 5, 1, BlkPtr(5), AbvPtr(3), &bSv[3]);
 	if (ntop) WriteBlkY(recon_y, 2, -1, AbvPtr(2));
 	if (ntop) WriteBlkY(recon_y, 3, -1, AbvPtr(3));
 	if (ntop) LogOutput(AbvPtr(2), 0);
@@ -428,7 +502,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 8
 	LogInput(BlkPtr(8), 0, 8);
-	if (nlef) deblock_y4(dbp, 8, 0, BlkPtr(8), LefPtr(13), &bSh[2]);
+	if (lfil) deblock_y4(dbp, 8, 0, BlkPtr(8), LefPtr(13), &bSh[2]);
 	if (nlef) WriteBlkY(recon_y, -1, 2, LefPtr(13));
 	if (nlef) LogOutput(LefPtr(13), 2);
 	LogStep();
@@ -443,7 +517,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 10
 	LogInput(BlkPtr(10), 0, 10);
-	if (nlef) deblock_y4(dbp, 10, 0, BlkPtr(10), LefPtr(15), &bSh[3]);
+	if (lfil) deblock_y4(dbp, 10, 0, BlkPtr(10), LefPtr(15), &bSh[3]);
 	if (nlbp) WriteBlkY(recon_y, -1, 3, LefPtr(15));
 	if (nlbp) LogOutput(LefPtr(15), 2);
 	if (nlef) CopyBlk(AlePtr(3), LefPtr(15));
@@ -509,7 +583,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 16
 	LogInput(BlkPtr(16), 2, 0);
-	if (nlef) deblock_c4(dbp, 0, 0, BlkPtr(16), LefPtr(17), &bSh[0]);
+	if (lfil) deblock_c4(dbp, 0, 0, BlkPtr(16), LefPtr(17), &bSh[0]);
 	if (nlef) WriteBlkC(recon_cb, -1, 0, LefPtr(17));
 	if (nlef) LogOutput(LefPtr(17), 2);
 	LogStep();
@@ -517,8 +591,8 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 	// 17
 	LogInput(BlkPtr(17), 2, 1);
 	if (alwy) deblock_c4(dbp, 1, 0, BlkPtr(17), BlkPtr(16), &bSh[8]);
-	if (ntop) deblock_c4(dbp, 0, 1, BlkPtr(16), AbvPtr(4), &bSv[0]);
-	if (ntop) deblock_c4(dbp, 1, 1, BlkPtr(17), AbvPtr(5), &bSv[2]);
+	if (tfil) deblock_c4(dbp, 0, 1, BlkPtr(16), AbvPtr(4), &bSv[0]);
+	if (tfil) deblock_c4(dbp, 1, 1, BlkPtr(17), AbvPtr(5), &bSv[2]);
 	if (ntop) WriteBlkC(recon_cb, 0, -1, AbvPtr(4));
 	if (ntop) WriteBlkC(recon_cb, 1, -1, AbvPtr(5));
 	if (ntop) LogOutput(AbvPtr(4), 0);
@@ -527,7 +601,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 18
 	LogInput(BlkPtr(18), 2, 2);
-	if (nlef) deblock_c4(dbp, 2, 0, BlkPtr(18), LefPtr(19), &bSh[2]);
+	if (lfil) deblock_c4(dbp, 2, 0, BlkPtr(18), LefPtr(19), &bSh[2]);
 	if (nlbp) WriteBlkC(recon_cb, -1, 1, LefPtr(19));
 	if (nlbp) LogOutput(LefPtr(19), 2);
 	if (nlef) CopyBlk(AlePtr(5), LefPtr(19));
@@ -552,7 +626,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 20
 	LogInput(BlkPtr(20), 3, 0);
-	if (nlef) deblock_c4(dbp, 0, 0, BlkPtr(20), LefPtr(21), &bSh[0]);
+	if (lfil) deblock_c4(dbp, 0, 0, BlkPtr(20), LefPtr(21), &bSh[0]);
 	if (nlef) WriteBlkC(recon_cr, -1, 0, LefPtr(21));
 	if (nlef) LogOutput(LefPtr(21), 2);
 	LogStep();
@@ -560,8 +634,8 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 	// 21
 	LogInput(BlkPtr(21), 3, 1);
 	if (alwy) deblock_c4(dbp, 1, 0, BlkPtr(21), BlkPtr(20), &bSh[8]);
-	if (ntop) deblock_c4(dbp, 0, 1, BlkPtr(20), AbvPtr(6), &bSv[0]);
-	if (ntop) deblock_c4(dbp, 1, 1, BlkPtr(21), AbvPtr(7), &bSv[2]);
+	if (tfil) deblock_c4(dbp, 0, 1, BlkPtr(20), AbvPtr(6), &bSv[0]);
+	if (tfil) deblock_c4(dbp, 1, 1, BlkPtr(21), AbvPtr(7), &bSv[2]);
 	if (ntop) WriteBlkC(recon_cr, 0, -1, AbvPtr(6));
 	if (ntop) WriteBlkC(recon_cr, 1, -1, AbvPtr(7));
 	if (ntop) LogOutput(AbvPtr(6), 0);
@@ -570,7 +644,7 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 	// 22
 	LogInput(BlkPtr(22), 3, 2);
-	if (nlef) deblock_c4(dbp, 2, 0, BlkPtr(22), LefPtr(23), &bSh[2]);
+	if (lfil) deblock_c4(dbp, 2, 0, BlkPtr(22), LefPtr(23), &bSh[2]);
 	if (nlbp) WriteBlkC(recon_cr, -1, 1, LefPtr(23));
 	if (nlbp) LogOutput(LefPtr(23), 2);
 	if (nlef) CopyBlk(AlePtr(7), LefPtr(23));
@@ -604,4 +678,631 @@ void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon
 
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Edge engine
+// Filters in spec order (8.7) in place on the byte recon: the luma vertical edges left to right,
+// then the horizontal edges top to bottom, each edge 16 samples at once with per lane bS.
+// Chroma does the same with cb and cr side by side in one 16 lane pass. The ring model's block
+// order only interleaves edges that do not touch the same samples, so the output is identical.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct _EdgeParam {
+	int alpha;
+	int beta;
+	unsigned char bs[16]; // per lane
+	unsigned char tc0[16];
+} EdgeParam;
+
+// Thresholds from the average qp across the edge, lane bS from the 4 segment bS's of the edge
+// (4 luma lanes per segment, 2 chroma lanes per segment in each of cb and cr)
+static void edge_param(DeblockCtx* dbp, EdgeParam* ep, int qpp, int qpq, const int* bS, int chroma)
+{
+	int qpavg = (qpp + qpq + 1) >> 1; // eqn (8-217)
+	int indexA = CLIP3(0, 51, qpavg + dbp->filterOffsetA);
+	int indexB = CLIP3(0, 51, qpavg + dbp->filterOffsetB);
+
+	ep->alpha = gg_dbk.alpha[indexA];
+	ep->beta = gg_dbk.beta[indexB];
+	for (int ll = 0; ll < 16; ll++) {
+		int b = bS[(chroma) ? (ll & 7) >> 1 : ll >> 2];
+		ep->bs[ll] = (unsigned char)b;
+		ep->tc0[ll] = (unsigned char)((b && b < 4) ? gg_dbk.tc0[b - 1][indexA] : 0);
+	}
+}
+
+#ifdef GG_DEBLOCK_SSE2
+
+#define ABSD16(a, b) _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a))
+#define SEL(m, a, b) _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+
+// 8 lanes widened to 16 bits, v[0..7] = p3 p2 p1 p0 q0 q1 q2 q3, filtered in place
+static void filter_lanes8(__m128i* v, __m128i bs, __m128i tc0, int alpha, int beta, int chroma)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i two = _mm_set1_epi16(2);
+	const __m128i four = _mm_set1_epi16(4);
+	const __m128i pmax = _mm_set1_epi16(255);
+	const __m128i va = _mm_set1_epi16((short)alpha);
+	const __m128i vb = _mm_set1_epi16((short)beta);
+	__m128i p3 = v[0], p2 = v[1], p1 = v[2], p0 = v[3];
+	__m128i q0 = v[4], q1 = v[5], q2 = v[6], q3 = v[7];
+
+	// filterSamplesFlag, eqn (8-224)
+	__m128i dpq = ABSD16(p0, q0);
+	__m128i filt = _mm_and_si128(_mm_cmpgt_epi16(bs, zero), _mm_cmplt_epi16(dpq, va));
+	filt = _mm_and_si128(filt, _mm_and_si128(_mm_cmplt_epi16(ABSD16(p1, p0), vb), _mm_cmplt_epi16(ABSD16(q1, q0), vb)));
+	__m128i strong = _mm_and_si128(filt, _mm_cmpeq_epi16(bs, four));
+	__m128i normal = _mm_andnot_si128(strong, filt);
+	__m128i ap = (chroma) ? zero : _mm_cmplt_epi16(ABSD16(p2, p0), vb);
+	__m128i aq = (chroma) ? zero : _mm_cmplt_epi16(ABSD16(q2, q0), vb);
+
+	// Bs 1, 2, 3
+	__m128i tc = (chroma) ? _mm_add_epi16(tc0, one) : _mm_sub_epi16(_mm_sub_epi16(tc0, ap), aq);
+	__m128i delta = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_sub_epi16(q0, p0), 2), _mm_sub_epi16(p1, q1)), four), 3);
+	delta = _mm_min_epi16(_mm_max_epi16(delta, _mm_sub_epi16(zero, tc)), tc);
+	__m128i np0 = _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(p0, delta), zero), pmax);
+	__m128i nq0 = _mm_min_epi16(_mm_max_epi16(_mm_sub_epi16(q0, delta), zero), pmax);
+
+	// Bs 4
+	__m128i sp0 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(p1, 1), p0), _mm_add_epi16(q1, two)), 2);
+	__m128i sq0 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(q1, 1), q0), _mm_add_epi16(p1, two)), 2);
+
+	if (!chroma) {
+		__m128i avg = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(p0, q0), one), 1);
+		__m128i ntc0 = _mm_sub_epi16(zero, tc0);
+		__m128i np1 = _mm_srai_epi16(_mm_sub_epi16(_mm_add_epi16(p2, avg), _mm_slli_epi16(p1, 1)), 1);
+		__m128i nq1 = _mm_srai_epi16(_mm_sub_epi16(_mm_add_epi16(q2, avg), _mm_slli_epi16(q1, 1)), 1);
+		np1 = SEL(ap, _mm_add_epi16(p1, _mm_min_epi16(_mm_max_epi16(np1, ntc0), tc0)), p1);
+		nq1 = SEL(aq, _mm_add_epi16(q1, _mm_min_epi16(_mm_max_epi16(nq1, ntc0), tc0)), q1);
+
+		__m128i small = _mm_cmplt_epi16(dpq, _mm_set1_epi16((short)((alpha >> 2) + 2)));
+		__m128i sp = _mm_and_si128(ap, small);
+		__m128i sq = _mm_and_si128(aq, small);
+		__m128i pq0 = _mm_add_epi16(p0, q0);
+		__m128i t;
+		// P
+		t = _mm_add_epi16(_mm_add_epi16(p2, q1), _mm_slli_epi16(_mm_add_epi16(p1, pq0), 1));
+		sp0 = SEL(sp, _mm_srai_epi16(_mm_add_epi16(t, four), 3), sp0);
+		__m128i sp1 = SEL(sp, _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(p2, p1), _mm_add_epi16(pq0, two)), 2), p1);
+		t = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(p3, 1), _mm_add_epi16(_mm_slli_epi16(p2, 1), p2)), _mm_add_epi16(p1, pq0));
+		__m128i sp2 = SEL(sp, _mm_srai_epi16(_mm_add_epi16(t, four), 3), p2);
+		// Q
+		t = _mm_add_epi16(_mm_add_epi16(q2, p1), _mm_slli_epi16(_mm_add_epi16(q1, pq0), 1));
+		sq0 = SEL(sq, _mm_srai_epi16(_mm_add_epi16(t, four), 3), sq0);
+		__m128i sq1 = SEL(sq, _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(q2, q1), _mm_add_epi16(pq0, two)), 2), q1);
+		t = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(q3, 1), _mm_add_epi16(_mm_slli_epi16(q2, 1), q2)), _mm_add_epi16(q1, pq0));
+		__m128i sq2 = SEL(sq, _mm_srai_epi16(_mm_add_epi16(t, four), 3), q2);
+
+		v[1] = SEL(strong, sp2, p2);
+		v[2] = SEL(strong, sp1, SEL(normal, np1, p1));
+		v[5] = SEL(strong, sq1, SEL(normal, nq1, q1));
+		v[6] = SEL(strong, sq2, q2);
+	}
+	v[3] = SEL(strong, sp0, SEL(normal, np0, p0));
+	v[4] = SEL(strong, sq0, SEL(normal, nq0, q0));
+}
+
+// 16 byte lanes, v[0..7] = p3 p2 p1 p0 q0 q1 q2 q3
+static void filter_lanes(__m128i* v, const EdgeParam* ep, int chroma)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo[8], hi[8];
+	__m128i bs = _mm_loadu_si128((const __m128i*)ep->bs);
+	__m128i tc0 = _mm_loadu_si128((const __m128i*)ep->tc0);
+
+	for (int ii = 0; ii < 8; ii++) {
+		lo[ii] = _mm_unpacklo_epi8(v[ii], zero);
+		hi[ii] = _mm_unpackhi_epi8(v[ii], zero);
+	}
+	filter_lanes8(lo, _mm_unpacklo_epi8(bs, zero), _mm_unpacklo_epi8(tc0, zero), ep->alpha, ep->beta, chroma);
+	filter_lanes8(hi, _mm_unpackhi_epi8(bs, zero), _mm_unpackhi_epi8(tc0, zero), ep->alpha, ep->beta, chroma);
+	for (int ii = 1; ii < 7; ii++)
+		v[ii] = _mm_packus_epi16(lo[ii], hi[ii]);
+}
+
+// 16 rows of 8 samples (row[ii] points at p3) to 8 vectors of 16 lanes, one per column
+static void load_cols(unsigned char** row, __m128i* v)
+{
+	__m128i a[8], b[8], c[8];
+	for (int ii = 0; ii < 8; ii++)
+		a[ii] = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)row[2 * ii]), _mm_loadl_epi64((const __m128i*)row[2 * ii + 1]));
+	for (int ii = 0; ii < 4; ii++) { // 4 rows x columns 0-3, 4-7
+		b[2 * ii] = _mm_unpacklo_epi16(a[2 * ii], a[2 * ii + 1]);
+		b[2 * ii + 1] = _mm_unpackhi_epi16(a[2 * ii], a[2 * ii + 1]);
+	}
+	for (int ii = 0; ii < 2; ii++) { // 8 rows x column pairs
+		c[4 * ii + 0] = _mm_unpacklo_epi32(b[4 * ii + 0], b[4 * ii + 2]);
+		c[4 * ii + 1] = _mm_unpackhi_epi32(b[4 * ii + 0], b[4 * ii + 2]);
+		c[4 * ii + 2] = _mm_unpacklo_epi32(b[4 * ii + 1], b[4 * ii + 3]);
+		c[4 * ii + 3] = _mm_unpackhi_epi32(b[4 * ii + 1], b[4 * ii + 3]);
+	}
+	for (int ii = 0; ii < 4; ii++) {
+		v[2 * ii] = _mm_unpacklo_epi64(c[ii], c[ii + 4]);
+		v[2 * ii + 1] = _mm_unpackhi_epi64(c[ii], c[ii + 4]);
+	}
+}
+
+// Inverse of load_cols
+static void store_cols(unsigned char** row, __m128i* v)
+{
+	__m128i a[8], b[8], c[8];
+	for (int ii = 0; ii < 4; ii++) { // column pairs x rows 0-7, 8-15
+		a[2 * ii] = _mm_unpacklo_epi8(v[2 * ii], v[2 * ii + 1]);
+		a[2 * ii + 1] = _mm_unpackhi_epi8(v[2 * ii], v[2 * ii + 1]);
+	}
+	for (int ii = 0; ii < 2; ii++) { // 4 rows x columns 0-3, 4-7
+		b[4 * ii + 0] = _mm_unpacklo_epi16(a[ii], a[ii + 2]);
+		b[4 * ii + 1] = _mm_unpackhi_epi16(a[ii], a[ii + 2]);
+		b[4 * ii + 2] = _mm_unpacklo_epi16(a[ii + 4], a[ii + 6]);
+		b[4 * ii + 3] = _mm_unpackhi_epi16(a[ii + 4], a[ii + 6]);
+	}
+	for (int ii = 0; ii < 2; ii++) { // row pairs
+		c[4 * ii + 0] = _mm_unpacklo_epi32(b[4 * ii + 0], b[4 * ii + 2]);
+		c[4 * ii + 1] = _mm_unpackhi_epi32(b[4 * ii + 0], b[4 * ii + 2]);
+		c[4 * ii + 2] = _mm_unpacklo_epi32(b[4 * ii + 1], b[4 * ii + 3]);
+		c[4 * ii + 3] = _mm_unpackhi_epi32(b[4 * ii + 1], b[4 * ii + 3]);
+	}
+	for (int ii = 0; ii < 8; ii++) {
+		_mm_storel_epi64((__m128i*)row[2 * ii], c[ii]);
+		_mm_storel_epi64((__m128i*)row[2 * ii + 1], _mm_srli_si128(c[ii], 8));
+	}
+}
+
+// Luma edge of 16 lines, vert_flag 0 an edge between columns (horizontal filter), 1 between rows
+static void edge_luma(unsigned char* pix, int stride, int vert_flag, const EdgeParam* ep)
+{
+	__m128i v[8];
+	if (!vert_flag) {
+		unsigned char* row[16];
+		for (int ii = 0; ii < 16; ii++)
+			row[ii] = pix + ii * stride - 4;
+		load_cols(row, v);
+		filter_lanes(v, ep, 0);
+		store_cols(row, v);
+	}
+	else {
+		for (int ii = 0; ii < 8; ii++)
+			v[ii] = _mm_loadu_si128((const __m128i*)(pix + (ii - 4) * stride));
+		filter_lanes(v, ep, 0);
+		for (int ii = 1; ii < 7; ii++)
+			_mm_storeu_si128((__m128i*)(pix + (ii - 4) * stride), v[ii]);
+	}
+}
+
+// Chroma edge of 8 lines in each of cb (lanes 0-7) and cr (lanes 8-15)
+static void edge_chroma(unsigned char* cb, unsigned char* cr, int stride, int vert_flag, const EdgeParam* ep)
+{
+	__m128i v[8];
+	if (!vert_flag) {
+		unsigned char* row[16];
+		for (int ii = 0; ii < 8; ii++) {
+			row[ii] = cb + ii * stride - 4;
+			row[ii + 8] = cr + ii * stride - 4;
+		}
+		load_cols(row, v);
+		filter_lanes(v, ep, 1);
+		store_cols(row, v);
+	}
+	else {
+		for (int ii = 0; ii < 8; ii++)
+			v[ii] = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(cb + (ii - 4) * stride)), _mm_loadl_epi64((const __m128i*)(cr + (ii - 4) * stride)));
+		filter_lanes(v, ep, 1);
+		for (int ii = 3; ii < 5; ii++) {
+			_mm_storel_epi64((__m128i*)(cb + (ii - 4) * stride), v[ii]);
+			_mm_storel_epi64((__m128i*)(cr + (ii - 4) * stride), _mm_srli_si128(v[ii], 8));
+		}
+	}
+}
+
+#else
+
+// One line across an edge, q points at q0, step is the distance to q1
+static void filter_line(unsigned char* q, int step, int bS, int tc0, int alpha, int beta, int chroma)
+{
+	int p0 = q[-step], p1 = q[-2 * step];
+	int q0 = q[0], q1 = q[step];
+	int p2, p3, q2, q3;
+	int ap, aq, tc, delta;
 
+	if (!bS || ABS(p0 - q0) >= alpha || ABS(p1 - p0) >= beta || ABS(q1 - q0) >= beta)
+		return;
+	if (chroma) {
+		if (bS == 4) {
+			q[-step] = (unsigned char)((2 * p1 + p0 + q1 + 2) >> 2);
+			q[0] = (unsigned char)((2 * q1 + q0 + p1 + 2) >> 2);
+		}
+		else {
+			tc = tc0 + 1;
+			delta = CLIP3(-tc, tc, (((q0 - p0) << 2) + (p1 - q1) + 4) >> 3);
+			q[-step] = (unsigned char)CLIP1(p0 + delta);
+			q[0] = (unsigned char)CLIP1(q0 - delta);
+		}
+		return;
+	}
+	p2 = q[-3 * step]; p3 = q[-4 * step];
+	q2 = q[2 * step]; q3 = q[3 * step];
+	ap = ABS(p2 - p0) < beta;
+	aq = ABS(q2 - q0) < beta;
+	if (bS == 4) {
+		int small = ABS(p0 - q0) < ((alpha >> 2) + 2);
+		if (ap && small) {
+			q[-step] = (unsigned char)((p2 + 2 * p1 + 2 * p0 + 2 * q0 + q1 + 4) >> 3);
+			q[-2 * step] = (unsigned char)((p2 + p1 + p0 + q0 + 2) >> 2);
+			q[-3 * step] = (unsigned char)((2 * p3 + 3 * p2 + p1 + p0 + q0 + 4) >> 3);
+		}
+		else
+			q[-step] = (unsigned char)((2 * p1 + p0 + q1 + 2) >> 2);
+		if (aq && small) {
+			q[0] = (unsigned char)((p1 + 2 * p0 + 2 * q0 + 2 * q1 + q2 + 4) >> 3);
+			q[step] = (unsigned char)((p0 + q0 + q1 + q2 + 2) >> 2);
+			q[2 * step] = (unsigned char)((2 * q3 + 3 * q2 + q1 + q0 + p0 + 4) >> 3);
+		}
+		else
+			q[0] = (unsigned char)((2 * q1 + q0 + p1 + 2) >> 2);
+		return;
+	}
+	tc = tc0 + ap + aq;
+	delta = CLIP3(-tc, tc, (((q0 - p0) << 2) + (p1 - q1) + 4) >> 3);
+	q[-step] = (unsigned char)CLIP1(p0 + delta);
+	q[0] = (unsigned char)CLIP1(q0 - delta);
+	if (ap)
+		q[-2 * step] = (unsigned char)(p1 + CLIP3(-tc0, tc0, (p2 + ((p0 + q0 + 1) >> 1) - (p1 << 1)) >> 1));
+	if (aq)
+		q[step] = (unsigned char)(q1 + CLIP3(-tc0, tc0, (q2 + ((p0 + q0 + 1) >> 1) - (q1 << 1)) >> 1));
+}
+
+static void edge_luma(unsigned char* pix, int stride, int vert_flag, const EdgeParam* ep)
+{
+	for (int ii = 0; ii < 16; ii++) {
+		if (!vert_flag)
+			filter_line(pix + ii * stride, 1, ep->bs[ii], ep->tc0[ii], ep->alpha, ep->beta, 0);
+		else
+			filter_line(pix + ii, stride, ep->bs[ii], ep->tc0[ii], ep->alpha, ep->beta, 0);
+	}
+}
+
+static void edge_chroma(unsigned char* cb, unsigned char* cr, int stride, int vert_flag, const EdgeParam* ep)
+{
+	for (int ii = 0; ii < 16; ii++) {
+		unsigned char* pix = (ii < 8) ? cb : cr;
+		if (!vert_flag)
+			filter_line(pix + (ii & 7) * stride, 1, ep->bs[ii], ep->tc0[ii], ep->alpha, ep->beta, 1);
+		else
+			filter_line(pix + (ii & 7), stride, ep->bs[ii], ep->tc0[ii], ep->alpha, ep->beta, 1);
+	}
+}
+
+#endif
+
+// Boundary strengths of the 32 edge segments of a mb as bit masks, bit edge*4+segment:
+// vertical edges (horizontal filtering) in bits 0-15, horizontal edges in bits 16-31.
+// Mb edges that are not filtered (picture or slice edge) are left out.
+typedef struct _EdgeMask {
+	unsigned int bs; // bS != 0
+	unsigned int bs2; // bS >= 2, coefficients on either side
+	unsigned int intra; // bS 4 on mb edges, 3 inside
+} EdgeMask;
+
+// 4x4 bit matrix transpose, bit y*4+x to bit x*4+y
+static unsigned int nz_transpose(unsigned int x)
+{
+	unsigned int t;
+	t = (x ^ (x >> 3)) & 0x0a0a; x ^= t ^ (t << 3);
+	t = (x ^ (x >> 6)) & 0x00cc; x ^= t ^ (t << 6);
+	return(x);
+}
+
+// Same result as edge_bs on every segment, from the nz masks in a few operations
+static void edge_mask(const MbInfo* cur, const MbInfo* lef, const MbInfo* abv, int lfil, int tfil, EdgeMask* em)
+{
+	unsigned int mask = 0xfff0fff0 | ((lfil) ? 0x0000000f : 0) | ((tfil) ? 0x000f0000 : 0);
+	unsigned int nzt = nz_transpose(cur->nz);
+	unsigned int h = nzt | (nzt << 4) | ((lfil) ? nz_transpose(lef->nz) >> 12 : 0); // p side is the block to the left
+	unsigned int v = cur->nz | (cur->nz << 4) | ((tfil) ? abv->nz >> 12 : 0); // p side is the block above
+	unsigned int ref = ((lfil && MB_MOTION_DIFF(lef, cur)) ? 0x0000000f : 0) | ((tfil && MB_MOTION_DIFF(abv, cur)) ? 0x000f0000 : 0);
+
+	em->intra = (MB_TYPE(cur) == GG_MBTYPE_INTRA) ? 0xffffffff : 0;
+	em->intra |= ((lfil && MB_TYPE(lef) == GG_MBTYPE_INTRA) ? 0x0000000f : 0) | ((tfil && MB_TYPE(abv) == GG_MBTYPE_INTRA) ? 0x000f0000 : 0);
+	em->intra &= mask;
+	em->bs2 = ((h & 0xffff) | (v << 16)) & mask;
+	em->bs = em->bs2 | ref | em->intra;
+	em->bs &= mask;
+}
+
+// bS 0 on every edge of the macroblock (skipped or static areas): nothing intra, no coefficients in the
+// macroblock or in the neighbour blocks along its filtered edges, same ref and mv. Same as edge_mask giving bs 0.
+static int mb_bypass(const MbInfo* cur, const MbInfo* lef, const MbInfo* abv)
+{
+	if (cur->nz || MB_TYPE(cur) == GG_MBTYPE_INTRA)
+		return(0);
+	if ((cur->type & MB_LFIL) && ((lef->nz & 0x8888) || MB_TYPE(lef) == GG_MBTYPE_INTRA || MB_MOTION_DIFF(lef, cur)))
+		return(0);
+	if ((cur->type & MB_TFIL) && ((abv->nz & 0xf000) || MB_TYPE(abv) == GG_MBTYPE_INTRA || MB_MOTION_DIFF(abv, cur)))
+		return(0);
+	return(1);
+}
+
+// The 4 segment bS's of the edge starting at mask bit
+static void edge_seg_bs(const EdgeMask* em, int bit, int* bS)
+{
+	for (int ss = 0; ss < 4; ss++) {
+		int bb = bit + ss;
+		bS[ss] = ((em->intra >> bb) & 1) ? (((bb & 15) < 4) ? 4 : 3) : ((em->bs2 >> bb) & 1) ? 2 : (em->bs >> bb) & 1;
+	}
+}
+
+static void deblock_mb_edges(DeblockCtx* dbp, int mbx, int mby, unsigned char* recon_y, unsigned char* recon_cb, unsigned char* recon_cr)
+{
+	const MbInfo* cur = &dbp->cur;
+	const MbInfo* lef = &dbp->mbi[(mbx) ? mbx - 1 : 0]; // only used when mbx > 0
+	const MbInfo* abv = &dbp->mbi[mbx]; // still the mb above
+	unsigned char* py, * pcb, * pcr;
+	int bS[4];
+	EdgeMask em;
+	EdgeParam ep;
+	int lfil, tfil;
+
+	// No pixel loads or stores when all edges have bS 0, only the macroblock info is kept
+	dbp->num_mb++;
+	if (mb_bypass(cur, lef, abv)) {
+		dbp->num_bypass++;
+		return;
+	}
+	py = recon_y + (mby * 16) * dbp->stride_y + mbx * 16;
+	pcb = recon_cb + (mby * 8) * dbp->stride_c + mbx * 8;
+	pcr = recon_cr + (mby * 8) * dbp->stride_c + mbx * 8;
+	lfil = (cur->type & MB_LFIL) ? 1 : 0;
+	tfil = (cur->type & MB_TFIL) ? 1 : 0;
+
+	// Boundary strengths, edges with bS 0 throughout cost no pixel work
+	edge_mask(cur, lef, abv, lfil, tfil, &em);
+
+	// Luma, vertical edges then horizontal edges
+	for (int ee = 0; ee < 4; ee++) {
+		if ((em.bs >> (ee * 4)) & 0xf) {
+			edge_seg_bs(&em, ee * 4, bS);
+			edge_param(dbp, &ep, (ee) ? cur->qp : lef->qp, cur->qp, bS, 0);
+			edge_luma(py + ee * 4, dbp->stride_y, 0, &ep);
+		}
+	}
+	for (int ee = 0; ee < 4; ee++) {
+		if ((em.bs >> (16 + ee * 4)) & 0xf) {
+			edge_seg_bs(&em, 16 + ee * 4, bS);
+			edge_param(dbp, &ep, (ee) ? cur->qp : abv->qp, cur->qp, bS, 0);
+			edge_luma(py + ee * 4 * dbp->stride_y, dbp->stride_y, 1, &ep);
+		}
+	}
+
+	// Chroma edges 0 and 4 take the bS of luma edges 0 and 8
+	for (int ee = 0; ee < 2; ee++) {
+		if ((em.bs >> (ee * 8)) & 0xf) {
+			edge_seg_bs(&em, ee * 8, bS);
+			edge_param(dbp, &ep, (ee) ? gg_quant.qpc[cur->qp] : gg_quant.qpc[lef->qp], gg_quant.qpc[cur->qp], bS, 1);
+			edge_chroma(pcb + ee * 4, pcr + ee * 4, dbp->stride_c, 0, &ep);
+		}
+	}
+	for (int ee = 0; ee < 2; ee++) {
+		if ((em.bs >> (16 + ee * 8)) & 0xf) {
+			edge_seg_bs(&em, 16 + ee * 8, bS);
+			edge_param(dbp, &ep, (ee) ? gg_quant.qpc[cur->qp] : gg_quant.qpc[abv->qp], gg_quant.qpc[cur->qp], bS, 1);
+			edge_chroma(pcb + ee * 4 * dbp->stride_c, pcr + ee * 4 * dbp->stride_c, dbp->stride_c, 1, &ep);
+		}
+	}
+}
+
+#ifdef DEBLOCK_SELF_TEST
+// Run the other engine on a copy of the picture, before the selected engine filters the macroblock
+// The engines share the macroblock info, only the ring model uses the ring and above row blocks
+static void deblock_self_test(DeblockCtx* dbp, int mbx, int mby, char* recon_y, char* recon_cb, char* recon_cr, int* num_coeff_y, int* num_coeff_cb, int* num_coeff_cr, int qp, int refidx, int mvx, int mvy, int mb_type)
+{
+	size_t size_y = (size_t)dbp->stride_y * dbp->mb_height * 16;
+	size_t size_c = (size_t)dbp->stride_c * dbp->mb_height * 8;
+	char* test_y, * test_cb, * test_cr;
+
+	if (test_size < size_y + 2 * size_c) {
+		free(test_buf);
+		test_buf = (char*)malloc(size_y + 2 * size_c);
+		test_size = (test_buf) ? size_y + 2 * size_c : 0;
+		if (!test_buf) {
+			printf("ERROR: out of memory for deblock self test\n");
+			return;
+		}
+	}
+	test_y = test_buf;
+	test_cb = test_buf + size_y;
+	test_cr = test_cb + size_c;
+
+	// Unfiltered macroblock, neighbours only ever filter into their own pixels
+	for (int py = 0; py < 16; py++)
+		memcpy(&test_y[(mby * 16 + py) * dbp->stride_y + mbx * 16], &recon_y[(mby * 16 + py) * dbp->stride_y + mbx * 16], 16);
+	for (int py = 0; py < 8; py++) {
+		memcpy(&test_cb[(mby * 8 + py) * dbp->stride_c + mbx * 8], &recon_cb[(mby * 8 + py) * dbp->stride_c + mbx * 8], 8);
+		memcpy(&test_cr[(mby * 8 + py) * dbp->stride_c + mbx * 8], &recon_cr[(mby * 8 + py) * dbp->stride_c + mbx * 8], 8);
+	}
+	if (dbp->mode == GG_DEBLOCK_RING)
+		deblock_mb_edges(dbp, mbx, mby, (unsigned char*)test_y, (unsigned char*)test_cb, (unsigned char*)test_cr);
+	else
+		deblock_mb_ring(dbp, mbx, mby, test_y, test_cb, test_cr, num_coeff_y, num_coeff_cb, num_coeff_cr, qp, refidx, mvx, mvy, mb_type);
+}
+
+// Compare the pictures once the last macroblock is filtered
+static void deblock_self_check(DeblockCtx* dbp, int mbx, int mby, char* recon_y, char* recon_cb, char* recon_cr)
+{
+	size_t size_y = (size_t)dbp->stride_y * dbp->mb_height * 16;
+	size_t size_c = (size_t)dbp->stride_c * dbp->mb_height * 8;
+	char* test_y = test_buf;
+	char* test_cb = test_buf + size_y;
+	char* test_cr = test_cb + size_c;
+	int errors = 0;
+
+	if (!test_buf || mbx != dbp->mb_width - 1 || mby != dbp->mb_height - 1)
+		return;
+	test_frames++;
+	for (int py = 0; py < dbp->mb_height * 16; py++)
+		for (int px = 0; px < dbp->mb_width * 16; px++)
+			errors += (test_y[py * dbp->stride_y + px] != recon_y[py * dbp->stride_y + px]) ? 1 : 0;
+	for (int py = 0; py < dbp->mb_height * 8; py++)
+		for (int px = 0; px < dbp->mb_width * 8; px++) {
+			errors += (test_cb[py * dbp->stride_c + px] != recon_cb[py * dbp->stride_c + px]) ? 1 : 0;
+			errors += (test_cr[py * dbp->stride_c + px] != recon_cr[py * dbp->stride_c + px]) ? 1 : 0;
+		}
+	if (errors)
+		printf("ERROR: deblock self test frame %d, fast and ring engines differ in %d samples\n", test_frames, errors);
+}
+#endif
+
+// Deblock a macroblock once its recon is final
+void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char *recon_y, char *recon_cb, char *recon_cr, int *num_coeff_y, int* num_coeff_cb, int *num_coeff_cr, int qp, int refidx, int mvx, int mvy, int mb_type)
+{
+	MbInfo mb;
+
+	// No function if deblocking disabled
+	if (dbp->disable_deblock_filter_idc == 1)
+		return;
+
+	mb.qp = (unsigned char)((mb_type == GG_MBTYPE_IPCM) ? 0 : qp);
+	mb.type = (unsigned char)(mb_type | (refidx << 2));
+	mb.mvx = (short)mvx;
+	mb.mvy = (short)mvy;
+	if (mbx && (dbp->disable_deblock_filter_idc != 2 || mby * dbp->mb_width + mbx - 1 >= dbp->first_mb)) // idc 2 stops at slice edges
+		mb.type |= MB_LFIL;
+	if (mby && (dbp->disable_deblock_filter_idc != 2 || (mby - 1) * dbp->mb_width + mbx >= dbp->first_mb))
+		mb.type |= MB_TFIL;
+	mb.nz = 0;
+	for (int bidx = 0; bidx < 16; bidx++) { // decode order to raster bits
+		int blkx = ((bidx & 1) ? 1 : 0) + ((bidx & 4) ? 2 : 0);
+		int blky = ((bidx & 2) ? 1 : 0) + ((bidx & 8) ? 2 : 0);
+		if (num_coeff_y[bidx])
+			mb.nz |= 1 << (blky * 4 + blkx);
+	}
+
+	// Row lagged, the side info is queued and the row handed over once complete
+	if (dbp->async_flag) {
+		DeblockRow* row;
+		if (mbx == 0) {
+			gg_mutex_lock(&dbp->lock);
+			while (dbp->q_len == GG_DEBLOCK_QUEUE) {
+				dbp->num_waits++;
+				gg_cond_wait(&dbp->cond, &dbp->lock);
+			}
+			dbp->q_fill = (dbp->q_head + dbp->q_len) % GG_DEBLOCK_QUEUE;
+			gg_mutex_unlock(&dbp->lock);
+			row = &dbp->queue[dbp->q_fill];
+			row->y = recon_y;
+			row->cb = recon_cb;
+			row->cr = recon_cr;
+			row->mby = mby;
+			row->filt = 0;
+		}
+		// The previous row of the picture is the slot before, left alone until this one is pushed
+		row = &dbp->queue[dbp->q_fill];
+		row->mb[mbx] = mb;
+		if (!mb_bypass(&mb, &row->mb[(mbx) ? mbx - 1 : 0], &dbp->queue[(dbp->q_fill + GG_DEBLOCK_QUEUE - 1) % GG_DEBLOCK_QUEUE].mb[mbx]))
+			row->filt++;
+		if (mbx == dbp->mb_width - 1) {
+			gg_mutex_lock(&dbp->lock);
+			dbp->q_len++;
+			gg_cond_broadcast(&dbp->cond);
+			gg_mutex_unlock(&dbp->lock);
+		}
+		return;
+	}
+
+	dbp->mbx = mbx;
+	dbp->cur = mb;
+#ifdef DEBLOCK_SELF_TEST
+	deblock_self_test(dbp, mbx, mby, recon_y, recon_cb, recon_cr, num_coeff_y, num_coeff_cb, num_coeff_cr, qp, refidx, mvx, mvy, mb_type);
+#endif
+	if (dbp->mode == GG_DEBLOCK_RING)
+		deblock_mb_ring(dbp, mbx, mby, recon_y, recon_cb, recon_cr, num_coeff_y, num_coeff_cb, num_coeff_cr, qp, refidx, mvx, mvy, mb_type);
+	else
+		deblock_mb_edges(dbp, mbx, mby, (unsigned char*)recon_y, (unsigned char*)recon_cb, (unsigned char*)recon_cr);
+#ifdef DEBLOCK_SELF_TEST
+	deblock_self_check(dbp, mbx, mby, recon_y, recon_cb, recon_cr);
+#endif
+	dbp->mbi[mbx] = dbp->cur;
+}
+
+// Deblock thread, filters queued rows in order with the edge engine
+static gg_thread_ret GG_THREAD_CALL deblock_thread(void* arg)
+{
+	DeblockCtx* dbp = (DeblockCtx*)arg;
+
+	gg_mutex_lock(&dbp->lock);
+	for (;;) {
+		DeblockRow* row;
+		while (!dbp->q_len && !dbp->stop)
+			gg_cond_wait(&dbp->cond, &dbp->lock);
+		if (!dbp->q_len)
+			break;
+		row = &dbp->queue[dbp->q_head];
+		gg_mutex_unlock(&dbp->lock);
+		if (!row->filt) { // static row
+			memcpy(dbp->mbi, row->mb, sizeof(MbInfo) * dbp->mb_width);
+			dbp->num_mb += dbp->mb_width;
+			dbp->num_bypass += dbp->mb_width;
+		}
+		for (int mbx = 0; mbx < dbp->mb_width && row->filt; mbx++) {
+			dbp->mbx = mbx;
+			dbp->cur = row->mb[mbx];
+			deblock_mb_edges(dbp, mbx, row->mby, (unsigned char*)row->y, (unsigned char*)row->cb, (unsigned char*)row->cr);
+			dbp->mbi[mbx] = dbp->cur;
+		}
+		gg_mutex_lock(&dbp->lock);
+		dbp->q_head = (dbp->q_head + 1) % GG_DEBLOCK_QUEUE;
+		dbp->q_len--;
+		gg_cond_broadcast(&dbp->cond);
+	}
+	gg_mutex_unlock(&dbp->lock);
+	return(0);
+}
+
+// Select the engine, with async_flag the fast engine runs on its own thread, a macroblock row or more behind the encoder
+// LOG_DEBLOCK builds use the ring model in line, its vectors are logged in macroblock order. So does the self test.
+int gg_deblock_open(DeblockCtx* dbp, int mode, int async_flag)
+{
+#ifdef LOG_DEBLOCK
+	mode = GG_DEBLOCK_RING;
+#endif
+#ifdef DEBLOCK_SELF_TEST
+	async_flag = 0;
+#endif
+	dbp->mode = mode;
+	if (mode != GG_DEBLOCK_FAST || !async_flag || dbp->async_flag)
+		return(0);
+	gg_mutex_init(&dbp->lock);
+	gg_cond_init(&dbp->cond);
+	dbp->q_head = 0;
+	dbp->q_len = 0;
+	dbp->stop = 0;
+	dbp->num_waits = 0;
+	if (gg_thread_create(&dbp->thread, deblock_thread, dbp)) {
+		printf("ERROR: could not start deblock thread, deblocking in line\n");
+		gg_cond_destroy(&dbp->cond);
+		gg_mutex_destroy(&dbp->lock);
+		return(-1);
+	}
+	dbp->async_flag = 1;
+	return(0);
+}
+
+// Wait until macroblock rows 0..rows-1 of a coded picture are filtered
+void gg_deblock_wait_rows(DeblockCtx* dbp, const char* pic_y, int rows)
+{
+	if (!dbp->async_flag || !pic_y)
+		return;
+	gg_mutex_lock(&dbp->lock);
+	for (;;) {
+		int busy = 0;
+		for (int ii = 0; ii < dbp->q_len && !busy; ii++) {
+			DeblockRow* row = &dbp->queue[(dbp->q_head + ii) % GG_DEBLOCK_QUEUE];
+			busy = (row->y == pic_y && row->mby <= rows);
+		}
+		if (!busy)
+			break;
+		dbp->num_waits++;
+		gg_cond_wait(&dbp->cond, &dbp->lock);
+	}
+	gg_mutex_unlock(&dbp->lock);
+}
@@ -1,15 +1,38 @@
 #pragma once
 
-typedef struct _BlkInfo {
-	int d[16]; // pixel data
-	int mb_type;
-	int qp;
-	int nz;
-	int oop;
-	int mvx;
-	int mvy;
-	int refidx;
-} BlkInfo;
+#include "gg_thread.h"
+
+// Filtering engines, bit exact with each other
+#define GG_DEBLOCK_FAST 0 // edge by edge on the frame buffer in macroblock order (SIMD), production
+#define GG_DEBLOCK_RING 1 // hardware order model, 4x4 blocks through a ring, writes the RTL test vectors (LOG_DEBLOCK)
+
+// 4x4 block of pixels, the side info of its macroblock is kept in MbInfo
+typedef struct _BlkPix {
+	unsigned char d[16];
+} BlkPix;
+
+// Macroblock side info for filtering, 8 bytes
+typedef struct _MbInfo {
+	unsigned short nz; // luma 4x4 blocks with coefficients, bit blky*4+blkx
+	unsigned char qp; // luma filtering qp, 0 for PCM
+	unsigned char type; // mb_type bits 0-1, refidx bits 2-3, left/top mb edge filtered bits 4/5
+	short mvx; // P_L0_16x16 motion, quarter luma samples (one mv per macroblock)
+	short mvy;
+} MbInfo;
+
+// Row lagged deblocking: the encoder queues the side info of each coded macroblock row and
+// a thread filters the rows in order behind it. A row is dequeued once filtered, so rows 0..n-1 of a
+// coded picture are final when none of its rows 0..n are queued (filtering row n touches row n-1).
+#define GG_DEBLOCK_QUEUE 4 // macroblock rows
+
+typedef struct _DeblockRow {
+	char* y; // picture
+	char* cb;
+	char* cr;
+	int mby;
+	int filt; // macroblocks with an edge to filter, 0-the thread only keeps the info
+	MbInfo* mb; // mb_width
+} DeblockRow;
 
 typedef struct _DeblockCtx {
 
@@ -19,18 +42,49 @@ typedef struct _DeblockCtx {
 	int filterOffsetB;
 	int mb_width;
 	int mb_height;
+	int first_mb; // first mb address of current slice
+	int stride_y; // recon row pitch
+	int stride_c;
 
-	// above/below row buffers of 4x4 blocks
-	BlkInfo abv[1024]; // pack y[4],cb[2],cr[2]
-	int mbx; // pointer into above arrays
+	// Macroblock info, entry mbx is the mb above until the current mb replaces it, entry mbx-1 the left mb
+	MbInfo* mbi; // mb_width
+	int mbi_size; // allocated entries
+	MbInfo cur; // mb being filtered
+	int mbx; // its column
+
+	// Ring model: above/below row buffer of 4x4 blocks
+	BlkPix* abv; // pack y[4],cb[2],cr[2] per mb, mb_width * 8
 
     // ring buffer of 4x4 blocks
-	BlkInfo ring[64];
+	BlkPix ring[64];
 	int ring_idx; // pointer into ring array
+	void (*log_out)(void* arg, const BlkPix* b, int dir); // optional, sees the ring model block writes in order (vector replay)
+	void* log_arg;
+
+	int mode; // GG_DEBLOCK_FAST or GG_DEBLOCK_RING
+
+	// Row lagged thread
+	int async_flag;
+	gg_thread_t thread;
+	gg_mutex_t lock;
+	gg_cond_t cond;
+	DeblockRow queue[GG_DEBLOCK_QUEUE];
+	int q_head;
+	int q_len; // queued rows, including the one being filtered
+	int q_fill; // slot the encoder is filling
+	int stop;
+	int num_waits; // times the encoder waited on the thread
+
+	// Stats
+	long long num_mb; // filtered by the fast engine
+	long long num_bypass; // of those, with bS 0 on every edge
 
 } DeblockCtx;
 
 void gg_deblock_close();
-void gg_deblock_init(DeblockCtx* dbp, int disable_deblock_filter_idc, int filterOffsetA, int filterOffsetB, int mb_width, int mb_height);
-void gg_deblock_init_row(DeblockCtx* dbp);
-void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char* recon_y, char* recon_cb, char* recon_cr, int* num_coeff_y, int* num_coeff_cb, int* num_coeff_cr, int qp, int refidx, int mb_type);
\ No newline at end of file
+void gg_deblock_init(DeblockCtx* dbp, int disable_deblock_filter_idc, int filterOffsetA, int filterOffsetB, int mb_width, int mb_height, int stride_y, int stride_c);
+void gg_deblock_free(DeblockCtx* dbp);
+int gg_deblock_open(DeblockCtx* dbp, int mode, int async_flag);
+void gg_deblock_wait_rows(DeblockCtx* dbp, const char* pic_y, int rows);
+void gg_deblock_init_slice(DeblockCtx* dbp, int first_mb);
+void gg_deblock_mb(DeblockCtx* dbp, int mbx, int mby, char* recon_y, char* recon_cb, char* recon_cr, int* num_coeff_y, int* num_coeff_cb, int* num_coeff_cr, int qp, int refidx, int mvx, int mvy, int mb_type);
\ No newline at end of file
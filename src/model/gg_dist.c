@@ -0,0 +1,406 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIST_HAVE_SSE2 1
+#if defined(__GNUC__) || defined(_MSC_VER)
+#include <immintrin.h>
+#define DIST_HAVE_AVX2 1 // built alongside, only selected when the cpu has it
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DIST_TARGET_AVX2
+#else
+#define DIST_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+#include "gg_dist.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Scalar reference
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static int sad_wxh(const unsigned char* a, int sa, const unsigned char* b, int sb, int w, int h)
+{
+	int sum = 0;
+	for (int yy = 0; yy < h; yy++, a += sa, b += sb)
+		for (int xx = 0; xx < w; xx++)
+			sum += (a[xx] > b[xx]) ? a[xx] - b[xx] : b[xx] - a[xx];
+	return(sum);
+}
+
+static int ssd_wxh(const unsigned char* a, int sa, const unsigned char* b, int sb, int w, int h)
+{
+	int sum = 0;
+	for (int yy = 0; yy < h; yy++, a += sa, b += sb)
+		for (int xx = 0; xx < w; xx++)
+			sum += (a[xx] - b[xx]) * (a[xx] - b[xx]);
+	return(sum);
+}
+
+// Sum of absolute 4x4 Hadamard coefficients, not yet halved
+static int satd_4x4_sum(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	int d[16], t[16];
+	int sum = 0;
+	for (int yy = 0; yy < 4; yy++)
+		for (int xx = 0; xx < 4; xx++)
+			d[yy * 4 + xx] = a[yy * sa + xx] - b[yy * sb + xx];
+	for (int ii = 0; ii < 4; ii++) { // rows
+		int s01 = d[ii * 4 + 0] + d[ii * 4 + 1], d01 = d[ii * 4 + 0] - d[ii * 4 + 1];
+		int s23 = d[ii * 4 + 2] + d[ii * 4 + 3], d23 = d[ii * 4 + 2] - d[ii * 4 + 3];
+		t[ii * 4 + 0] = s01 + s23;
+		t[ii * 4 + 1] = s01 - s23;
+		t[ii * 4 + 2] = d01 + d23;
+		t[ii * 4 + 3] = d01 - d23;
+	}
+	for (int ii = 0; ii < 4; ii++) { // columns
+		int s01 = t[ii] + t[4 + ii], d01 = t[ii] - t[4 + ii];
+		int s23 = t[8 + ii] + t[12 + ii], d23 = t[8 + ii] - t[12 + ii];
+		sum += abs(s01 + s23) + abs(s01 - s23) + abs(d01 + d23) + abs(d01 - d23);
+	}
+	return(sum);
+}
+
+static int satd_wxh(const unsigned char* a, int sa, const unsigned char* b, int sb, int w, int h)
+{
+	int sum = 0;
+	for (int yy = 0; yy < h; yy += 4)
+		for (int xx = 0; xx < w; xx += 4)
+			sum += satd_4x4_sum(a + yy * sa + xx, sa, b + yy * sb + xx, sb);
+	return(sum >> 1);
+}
+
+static int sad_4x4_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(sad_wxh(a, sa, b, sb, 4, 4)); }
+static int sad_8x8_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(sad_wxh(a, sa, b, sb, 8, 8)); }
+static int sad_16x16_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(sad_wxh(a, sa, b, sb, 16, 16)); }
+static int ssd_4x4_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(ssd_wxh(a, sa, b, sb, 4, 4)); }
+static int ssd_8x8_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(ssd_wxh(a, sa, b, sb, 8, 8)); }
+static int ssd_16x16_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(ssd_wxh(a, sa, b, sb, 16, 16)); }
+static int satd_4x4_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(satd_wxh(a, sa, b, sb, 4, 4)); }
+static int satd_8x8_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(satd_wxh(a, sa, b, sb, 8, 8)); }
+static int satd_16x16_c(const unsigned char* a, int sa, const unsigned char* b, int sb) { return(satd_wxh(a, sa, b, sb, 16, 16)); }
+
+static const DistFuncs dist_scalar = {
+	{ sad_4x4_c, sad_8x8_c, sad_16x16_c },
+	{ ssd_4x4_c, ssd_8x8_c, ssd_16x16_c },
+	{ satd_4x4_c, satd_8x8_c, satd_16x16_c },
+	GG_DIST_SCALAR
+};
+
+DistFuncs gg_dist = {
+	{ sad_4x4_c, sad_8x8_c, sad_16x16_c },
+	{ ssd_4x4_c, ssd_8x8_c, ssd_16x16_c },
+	{ satd_4x4_c, satd_8x8_c, satd_16x16_c },
+	GG_DIST_SCALAR
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// SSE2
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef DIST_HAVE_SSE2
+
+static __m128i load4(const unsigned char* p)
+{
+	int v;
+	memcpy(&v, p, 4);
+	return(_mm_cvtsi32_si128(v));
+}
+
+static int hsum64(__m128i s) // two 64 bit halves, from psadbw
+{
+	return(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+}
+
+static int hsum32(__m128i s)
+{
+	s = _mm_add_epi32(s, _mm_srli_si128(s, 8));
+	s = _mm_add_epi32(s, _mm_srli_si128(s, 4));
+	return(_mm_cvtsi128_si32(s));
+}
+
+static int sad_4x4_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i va = _mm_unpacklo_epi64(_mm_unpacklo_epi32(load4(a), load4(a + sa)), _mm_unpacklo_epi32(load4(a + 2 * sa), load4(a + 3 * sa)));
+	__m128i vb = _mm_unpacklo_epi64(_mm_unpacklo_epi32(load4(b), load4(b + sb)), _mm_unpacklo_epi32(load4(b + 2 * sb), load4(b + 3 * sb)));
+	return(hsum64(_mm_sad_epu8(va, vb)));
+}
+
+static int sad_8x8_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (int yy = 0; yy < 8; yy += 2, a += 2 * sa, b += 2 * sb) {
+		__m128i va = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)a), _mm_loadl_epi64((const __m128i*)(a + sa)));
+		__m128i vb = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)b), _mm_loadl_epi64((const __m128i*)(b + sb)));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+	return(hsum64(acc));
+}
+
+static int sad_16x16_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (int yy = 0; yy < 16; yy++, a += sa, b += sb)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+	return(hsum64(acc));
+}
+
+// Squared differences of 8 widened samples, added pairwise into 4 dwords
+static __m128i ssd_8(__m128i va, __m128i vb)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i d = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+	return(_mm_madd_epi16(d, d));
+}
+
+static int ssd_4x4_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = ssd_8(_mm_unpacklo_epi32(load4(a), load4(a + sa)), _mm_unpacklo_epi32(load4(b), load4(b + sb)));
+	acc = _mm_add_epi32(acc, ssd_8(_mm_unpacklo_epi32(load4(a + 2 * sa), load4(a + 3 * sa)), _mm_unpacklo_epi32(load4(b + 2 * sb), load4(b + 3 * sb))));
+	return(hsum32(acc));
+}
+
+static int ssd_8x8_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (int yy = 0; yy < 8; yy++, a += sa, b += sb)
+		acc = _mm_add_epi32(acc, ssd_8(_mm_loadl_epi64((const __m128i*)a), _mm_loadl_epi64((const __m128i*)b)));
+	return(hsum32(acc));
+}
+
+// 16 samples of one row
+static __m128i ssd_16(const unsigned char* a, const unsigned char* b)
+{
+	__m128i va = _mm_loadu_si128((const __m128i*)a);
+	__m128i vb = _mm_loadu_si128((const __m128i*)b);
+	return(_mm_add_epi32(ssd_8(va, vb), ssd_8(_mm_srli_si128(va, 8), _mm_srli_si128(vb, 8))));
+}
+
+static int ssd_16x16_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (int yy = 0; yy < 16; yy++, a += sa, b += sb)
+		acc = _mm_add_epi32(acc, ssd_16(a, b));
+	return(hsum32(acc));
+}
+
+// Two 4x4 blocks side by side, one per 64 bit half: vertical butterflies on rows,
+// a 4x4 transpose inside each half, then the horizontal butterflies.
+// Returns the absolute coefficient sums in 4 dwords. Coefficients stay within +-4080.
+#define HADAMARD4(type, d0, d1, d2, d3, add, sub) { \
+	type s01 = add(d0, d1), d01 = sub(d0, d1), s23 = add(d2, d3), d23 = sub(d2, d3); \
+	d0 = add(s01, s23); d1 = sub(s01, s23); d2 = add(d01, d23); d3 = sub(d01, d23); }
+
+static __m128i satd_8x4_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i d[4], t0, t1, t2, t3;
+	for (int ii = 0; ii < 4; ii++, a += sa, b += sb) {
+		__m128i va = (width == 8) ? _mm_loadl_epi64((const __m128i*)a) : load4(a);
+		__m128i vb = (width == 8) ? _mm_loadl_epi64((const __m128i*)b) : load4(b);
+		d[ii] = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+	}
+	HADAMARD4(__m128i, d[0], d[1], d[2], d[3], _mm_add_epi16, _mm_sub_epi16);
+	t0 = _mm_unpacklo_epi16(d[0], d[1]);
+	t1 = _mm_unpackhi_epi16(d[0], d[1]);
+	t2 = _mm_unpacklo_epi16(d[2], d[3]);
+	t3 = _mm_unpackhi_epi16(d[2], d[3]);
+	d[0] = _mm_unpacklo_epi32(t0, t2); // columns 0,1 of the left block
+	d[1] = _mm_unpackhi_epi32(t0, t2); // columns 2,3
+	d[2] = _mm_unpacklo_epi32(t1, t3); // right block
+	d[3] = _mm_unpackhi_epi32(t1, t3);
+	t0 = _mm_unpacklo_epi64(d[0], d[2]);
+	t1 = _mm_unpackhi_epi64(d[0], d[2]);
+	t2 = _mm_unpacklo_epi64(d[1], d[3]);
+	t3 = _mm_unpackhi_epi64(d[1], d[3]);
+	HADAMARD4(__m128i, t0, t1, t2, t3, _mm_add_epi16, _mm_sub_epi16);
+	t0 = _mm_max_epi16(t0, _mm_sub_epi16(zero, t0));
+	t1 = _mm_max_epi16(t1, _mm_sub_epi16(zero, t1));
+	t2 = _mm_max_epi16(t2, _mm_sub_epi16(zero, t2));
+	t3 = _mm_max_epi16(t3, _mm_sub_epi16(zero, t3));
+	return(_mm_madd_epi16(_mm_add_epi16(_mm_add_epi16(t0, t1), _mm_add_epi16(t2, t3)), _mm_set1_epi16(1)));
+}
+
+static int satd_4x4_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	return(hsum32(satd_8x4_sse2(a, sa, b, sb, 4)) >> 1);
+}
+
+static int satd_8x8_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = satd_8x4_sse2(a, sa, b, sb, 8);
+	acc = _mm_add_epi32(acc, satd_8x4_sse2(a + 4 * sa, sa, b + 4 * sb, sb, 8));
+	return(hsum32(acc) >> 1);
+}
+
+static int satd_16x16_sse2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (int yy = 0; yy < 16; yy += 4)
+		for (int xx = 0; xx < 16; xx += 8)
+			acc = _mm_add_epi32(acc, satd_8x4_sse2(a + yy * sa + xx, sa, b + yy * sb + xx, sb, 8));
+	return(hsum32(acc) >> 1);
+}
+
+static const DistFuncs dist_sse2 = {
+	{ sad_4x4_sse2, sad_8x8_sse2, sad_16x16_sse2 },
+	{ ssd_4x4_sse2, ssd_8x8_sse2, ssd_16x16_sse2 },
+	{ satd_4x4_sse2, satd_8x8_sse2, satd_16x16_sse2 },
+	GG_DIST_SSE2
+};
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// AVX2, 16x16 only (two rows or two 8x4 pairs per register), smaller blocks stay on SSE2
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef DIST_HAVE_AVX2
+
+DIST_TARGET_AVX2 static __m256i load2x16(const unsigned char* p, int stride)
+{
+	return(_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + stride)), 1));
+}
+
+DIST_TARGET_AVX2 static int hsum32x8(__m256i s)
+{
+	return(hsum32(_mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1))));
+}
+
+DIST_TARGET_AVX2 static int sad_16x16_avx2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (int yy = 0; yy < 16; yy += 2, a += 2 * sa, b += 2 * sb)
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(load2x16(a, sa), load2x16(b, sb)));
+	return(hsum32x8(acc)); // psadbw leaves the upper dwords zero
+}
+
+DIST_TARGET_AVX2 static int ssd_16x16_avx2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (int yy = 0; yy < 16; yy++, a += sa, b += sb) {
+		__m256i d = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)a)), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)b)));
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d, d));
+	}
+	return(hsum32x8(acc));
+}
+
+// Four 4x4 blocks across 16 columns, the 128 bit lanes each hold the SSE2 8x4 layout
+DIST_TARGET_AVX2 static int satd_16x16_avx2(const unsigned char* a, int sa, const unsigned char* b, int sb)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (int yy = 0; yy < 16; yy += 4, a += 4 * sa, b += 4 * sb) {
+		__m256i d[4], t0, t1, t2, t3;
+		for (int ii = 0; ii < 4; ii++)
+			d[ii] = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + ii * sa))), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + ii * sb))));
+		// after the widening, lane 0 holds columns 0-7 and lane 1 columns 8-15
+		HADAMARD4(__m256i, d[0], d[1], d[2], d[3], _mm256_add_epi16, _mm256_sub_epi16);
+		t0 = _mm256_unpacklo_epi16(d[0], d[1]);
+		t1 = _mm256_unpackhi_epi16(d[0], d[1]);
+		t2 = _mm256_unpacklo_epi16(d[2], d[3]);
+		t3 = _mm256_unpackhi_epi16(d[2], d[3]);
+		d[0] = _mm256_unpacklo_epi32(t0, t2);
+		d[1] = _mm256_unpackhi_epi32(t0, t2);
+		d[2] = _mm256_unpacklo_epi32(t1, t3);
+		d[3] = _mm256_unpackhi_epi32(t1, t3);
+		t0 = _mm256_unpacklo_epi64(d[0], d[2]);
+		t1 = _mm256_unpackhi_epi64(d[0], d[2]);
+		t2 = _mm256_unpacklo_epi64(d[1], d[3]);
+		t3 = _mm256_unpackhi_epi64(d[1], d[3]);
+		HADAMARD4(__m256i, t0, t1, t2, t3, _mm256_add_epi16, _mm256_sub_epi16);
+		t0 = _mm256_add_epi16(_mm256_add_epi16(_mm256_abs_epi16(t0), _mm256_abs_epi16(t1)), _mm256_add_epi16(_mm256_abs_epi16(t2), _mm256_abs_epi16(t3)));
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(t0, _mm256_set1_epi16(1)));
+	}
+	return(hsum32x8(acc) >> 1);
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Selection
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static int dist_cpu_level(void)
+{
+#ifdef DIST_HAVE_AVX2
+#ifdef _MSC_VER
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] >= 7) {
+		__cpuid(r, 1);
+		if ((r[2] & (1 << 27)) && (r[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) { // OS saves the ymm state
+			__cpuidex(r, 7, 0);
+			if (r[1] & (1 << 5))
+				return(GG_DIST_AVX2);
+		}
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return(GG_DIST_AVX2);
+#endif
+#endif
+#ifdef DIST_HAVE_SSE2
+	return(GG_DIST_SSE2);
+#else
+	return(GG_DIST_SCALAR);
+#endif
+}
+
+int gg_dist_init(int level)
+{
+	int cpu = dist_cpu_level();
+	if (level < 0 || level > cpu)
+		level = cpu;
+	gg_dist = dist_scalar;
+#ifdef DIST_HAVE_SSE2
+	if (level >= GG_DIST_SSE2)
+		gg_dist = dist_sse2;
+#endif
+#ifdef DIST_HAVE_AVX2
+	if (level >= GG_DIST_AVX2) {
+		gg_dist.sad[GG_DIST_16x16] = sad_16x16_avx2;
+		gg_dist.ssd[GG_DIST_16x16] = ssd_16x16_avx2;
+		gg_dist.satd[GG_DIST_16x16] = satd_16x16_avx2;
+		gg_dist.level = GG_DIST_AVX2;
+	}
+#endif
+	return(gg_dist.level);
+}
+
+const char* gg_dist_name(int level)
+{
+	return((level == GG_DIST_AVX2) ? "avx2" : (level == GG_DIST_SSE2) ? "sse2" : "scalar");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Picture level
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+long long gg_dist_ssd_plane(const unsigned char* a, int stride_a, int step_a, const unsigned char* b, int stride_b, int width, int height)
+{
+	long long sum = 0;
+	for (int yy = 0; yy < height; yy++, a += (long long)stride_a, b += (long long)stride_b) {
+		int xx = 0;
+#ifdef DIST_HAVE_SSE2
+		if (step_a == 1 && gg_dist.level >= GG_DIST_SSE2) {
+			__m128i acc = _mm_setzero_si128();
+			for (; xx + 16 <= width; xx += 16)
+				acc = _mm_add_epi32(acc, ssd_16(a + xx, b + xx));
+			sum += hsum32(acc); // fits 31 bits for rows up to 32k samples
+		}
+#endif
+		for (; xx < width; xx++)
+			sum += (a[xx * step_a] - b[xx]) * (a[xx * step_a] - b[xx]);
+	}
+	return(sum);
+}
+
+double gg_dist_psnr(long long ssd, long long num_samples)
+{
+	if (ssd <= 0 || num_samples <= 0)
+		return(100.0);
+	return(10.0 * log10(255.0 * 255.0 * (double)num_samples / (double)ssd));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Block distortion kernels: SAD, SSD and 4x4 Hadamard SATD between two 8 bit blocks
+// Each side has its own row pitch, so frame planes, macroblock buffers and tiles mix freely.
+// Chroma 8x8 blocks use the 8x8 kernels. SATD of a larger block is the sum over its 4x4 sub blocks, halved.
+
+#define GG_DIST_4x4   0
+#define GG_DIST_8x8   1
+#define GG_DIST_16x16 2
+#define GG_DIST_SIZES 3
+
+// Instruction set levels
+#define GG_DIST_AUTO   -1 // best the cpu supports
+#define GG_DIST_SCALAR  0
+#define GG_DIST_SSE2    1
+#define GG_DIST_AVX2    2
+
+typedef int (*DistFunc)(const unsigned char* a, int stride_a, const unsigned char* b, int stride_b);
+
+typedef struct _DistFuncs {
+	DistFunc sad[GG_DIST_SIZES];
+	DistFunc ssd[GG_DIST_SIZES];
+	DistFunc satd[GG_DIST_SIZES];
+	int level; // GG_DIST_SCALAR, _SSE2 or _AVX2
+} DistFuncs;
+
+extern DistFuncs gg_dist; // scalar until gg_dist_init()
+
+int gg_dist_init(int level); // returns the level selected, capped at what the cpu supports
+const char* gg_dist_name(int level);
+
+// Whole plane sum of squared differences, step_a is the sample step of a (2 for NV12 chroma)
+long long gg_dist_ssd_plane(const unsigned char* a, int stride_a, int step_a, const unsigned char* b, int stride_b, int width, int height);
+double gg_dist_psnr(long long ssd, long long num_samples); // 8 bit peak, 100 dB when identical
@@ -0,0 +1,649 @@
+#define _CRT_SECURE_NO_WARNINGS 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GG_INPUT_SSE2 1
+#endif
+#include "gg_alloc.h"
+#include "gg_input.h"
+
+// Set the frame geometry, stride is the luma row pitch in the file (0 for tightly packed)
+// Chroma pitch is stride/2 for planar I420, stride for the interleaved NV12 cb/cr plane
+static void input_format(YuvInput* in, int width, int height, int stride, int format)
+{
+	in->width = width;
+	in->height = height;
+	in->format = format;
+	in->stride_y = (stride) ? stride : width;
+	in->stride_c = (format == GG_YUV_NV12) ? in->stride_y : in->stride_y >> 1;
+	in->frame_size = (long long)in->stride_y * height + (long long)in->stride_c * (height >> 1) * ((format == GG_YUV_NV12) ? 1 : 2);
+}
+
+static void input_frame_ptrs(YuvInput* in, YuvFrame* frame, unsigned char* p)
+{
+	frame->y = (char*)p;
+	frame->cb = (char*)(p + (long long)in->stride_y * in->height);
+	if (in->format == GG_YUV_NV12) {
+		frame->cr = frame->cb + 1;
+		frame->chroma_step = 2;
+	}
+	else {
+		frame->cr = frame->cb + (long long)in->stride_c * (in->height >> 1);
+		frame->chroma_step = 1;
+	}
+	frame->stride_y = in->stride_y;
+	frame->stride_c = in->stride_c;
+	frame->width = in->width;
+	frame->height = in->height;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Memory mapped file input
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static void input_map_close(YuvInput* in)
+{
+#ifdef _WIN32
+	if (in->map)
+		UnmapViewOfFile(in->map);
+	if (in->mapping)
+		CloseHandle(in->mapping);
+	if (in->file != INVALID_HANDLE_VALUE)
+		CloseHandle(in->file);
+	in->mapping = NULL;
+	in->file = INVALID_HANDLE_VALUE;
+#else
+	if (in->map)
+		munmap(in->map, in->map_len);
+	if (in->fd >= 0)
+		close(in->fd);
+	in->fd = -1;
+#endif
+	in->map = NULL;
+}
+
+// Map a regular file, frames are read in place from the mapping
+// Returns 1 if the file can not be mapped (pipe, device) or holds y4m (whatever its name), so it is streamed instead
+static int input_map_open(YuvInput* in, const char* filename)
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	in->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (in->file == INVALID_HANDLE_VALUE) {
+		printf("ERROR: could not open input %s\n", filename);
+		return(-1);
+	}
+	if (GetFileType(in->file) != FILE_TYPE_DISK || !GetFileSizeEx(in->file, &size)) {
+		CloseHandle(in->file);
+		in->file = INVALID_HANDLE_VALUE;
+		return(1);
+	}
+	in->map_len = size.QuadPart;
+	in->mapping = CreateFileMappingA(in->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (in->mapping) {
+		in->map = (unsigned char*)MapViewOfFile(in->mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	struct stat st;
+	in->fd = open(filename, O_RDONLY);
+	if (in->fd < 0 || fstat(in->fd, &st) < 0) {
+		printf("ERROR: could not open input %s\n", filename);
+		return(-1);
+	}
+	if (!S_ISREG(st.st_mode)) {
+		close(in->fd);
+		in->fd = -1;
+		return(1);
+	}
+	in->map_len = st.st_size;
+	in->map = (unsigned char*)mmap(NULL, in->map_len, PROT_READ, MAP_PRIVATE, in->fd, 0);
+	if (in->map == MAP_FAILED) {
+		in->map = NULL;
+	}
+	else {
+		madvise(in->map, in->map_len, MADV_SEQUENTIAL);
+	}
+#endif
+	if (in->map == NULL) {
+		printf("ERROR: could not map input %s\n", filename);
+		return(-1);
+	}
+	if (in->map_len >= 9 && !memcmp(in->map, "YUV4MPEG2", 9)) {
+		input_map_close(in);
+		return(1);
+	}
+	if (in->frame_size <= 0) {
+		printf("ERROR: raw input %s needs a picture size\n", filename);
+		return(-1);
+	}
+	in->num_frames = in->map_len / in->frame_size;
+	printf("Input %s %dx%d stride %d, %lld frames\n", filename, in->width, in->height, in->stride_y, in->num_frames);
+	return(0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Streamed input, raw yuv or y4m
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Read from the stream, probe bytes first
+static long long input_fread(YuvInput* in, unsigned char* dst, long long len)
+{
+	long long n = 0;
+	while (n < len && in->peek_pos < in->peek_len)
+		dst[n++] = in->peek[in->peek_pos++];
+	return(n + (long long)fread(dst + n, 1, (size_t)(len - n), in->fp));
+}
+
+// Read a header line (without the '\n'), returns -1 at end of stream
+static int input_getline(YuvInput* in, char* line, int size)
+{
+	int len = 0;
+	unsigned char c;
+	for (;;) {
+		if (input_fread(in, &c, 1) != 1)
+			return(-1);
+		if (c == '\n')
+			break;
+		if (len < size - 1)
+			line[len++] = c;
+	}
+	line[len] = 0;
+	return(len);
+}
+
+// Parse the y4m stream header parameters following "YUV4MPEG2"
+static int input_y4m_header(YuvInput* in)
+{
+	char line[256];
+	char* tok;
+	int width = 0, height = 0;
+
+	if (input_getline(in, line, sizeof(line)) < 0)
+		return(-1);
+	for (tok = strtok(line, " "); tok; tok = strtok(NULL, " ")) {
+		switch (tok[0]) {
+		case 'W': width = atoi(tok + 1); break;
+		case 'H': height = atoi(tok + 1); break;
+		case 'F': if (sscanf(tok + 1, "%d:%d", &in->fps_num, &in->fps_den) != 2) in->fps_num = in->fps_den = 0; break;
+		case 'C':
+			if (strcmp(tok + 1, "420") && strcmp(tok + 1, "420jpeg") && strcmp(tok + 1, "420paldv") && strcmp(tok + 1, "420mpeg2")) {
+				printf("ERROR: y4m colorspace %s not supported, 8 bit 4:2:0 only\n", tok + 1);
+				return(-1);
+			}
+			break;
+		case 'I':
+			if (tok[1] != 'p' && tok[1] != '?')
+				printf("Warning: y4m interlaced input coded as progressive frames\n");
+			break;
+		default: break;
+		}
+	}
+	if (width <= 0 || height <= 0) {
+		printf("ERROR: y4m header without picture size\n");
+		return(-1);
+	}
+	input_format(in, width, height, 0, GG_YUV_I420);
+	return(0);
+}
+
+// Read the next frame into buf, returns 1 at end of stream
+static int input_stream_frame(YuvInput* in, unsigned char* buf)
+{
+	char line[256];
+	if (in->y4m_flag) {
+		if (input_getline(in, line, sizeof(line)) < 0)
+			return(1);
+		if (strncmp(line, "FRAME", 5)) {
+			printf("ERROR: y4m frame header expected\n");
+			return(1);
+		}
+	}
+	return((input_fread(in, buf, in->frame_size) == in->frame_size) ? 0 : 1);
+}
+
+// Reader thread, fills free pool buffers in order until end of stream or close
+static gg_thread_ret GG_THREAD_CALL input_reader(void* arg)
+{
+	YuvInput* in = (YuvInput*)arg;
+	int idx = 0;
+	int stop, eos;
+
+	for (;;) {
+		YuvSlot* slot = &in->slot[idx];
+		gg_mutex_lock(&in->lock);
+		while (slot->state != GG_SLOT_FREE && !in->stop)
+			gg_cond_wait(&in->cond, &in->lock);
+		stop = in->stop;
+		gg_mutex_unlock(&in->lock);
+		if (stop)
+			break;
+
+		eos = input_stream_frame(in, slot->buf);
+
+		gg_mutex_lock(&in->lock);
+		slot->state = (eos) ? GG_SLOT_EOS : GG_SLOT_READY;
+		slot->rows = in->mb_rows;
+		gg_cond_broadcast(&in->cond);
+		gg_mutex_unlock(&in->lock);
+		if (eos)
+			break;
+		idx = (idx + 1) % GG_INPUT_POOL;
+	}
+	return(0);
+}
+
+// Allocate the frame buffer pool shared by the reader (or raster producer) and the encoder
+static int input_pool_init(YuvInput* in)
+{
+	for (int ii = 0; ii < GG_INPUT_POOL; ii++) {
+		in->slot[ii].buf = (unsigned char*)gg_alloc(in->frame_size, 0);
+		if (!in->slot[ii].buf) {
+			printf("ERROR: out of memory for input buffers\n");
+			return(-1);
+		}
+		input_frame_ptrs(in, &in->slot[ii].frame, in->slot[ii].buf);
+		in->slot[ii].state = GG_SLOT_FREE;
+		in->slot[ii].rows = 0;
+	}
+	in->mb_rows = (in->height + 15) >> 4;
+	in->rd_idx = 0;
+	in->wr_idx = 0;
+	in->wr_rows = 0;
+	in->held = -1;
+	in->stop = 0;
+	in->num_waits = 0;
+	gg_mutex_init(&in->lock);
+	gg_cond_init(&in->cond);
+	in->lock_flag = 1;
+	return(0);
+}
+
+static int input_stream_open(YuvInput* in, const char* filename)
+{
+	in->stream_flag = 1;
+	setvbuf(in->fp, NULL, _IOFBF, 1 << 20);
+
+	// Probe for a y4m header, otherwise the bytes are the start of the first raw frame
+	in->peek_len = (int)fread(in->peek, 1, 9, in->fp);
+	in->peek_pos = 0;
+	if (in->peek_len == 9 && !memcmp(in->peek, "YUV4MPEG2", 9)) {
+		in->peek_pos = 9;
+		in->y4m_flag = 1;
+		if (input_y4m_header(in))
+			return(-1);
+	}
+	else if (in->width <= 0 || in->height <= 0) {
+		printf("ERROR: raw input %s needs a picture size\n", filename);
+		return(-1);
+	}
+
+	if (input_pool_init(in))
+		return(-1);
+	if (gg_thread_create(&in->thread, input_reader, in)) {
+		printf("ERROR: could not start input reader\n");
+		return(-1);
+	}
+	in->stream_flag = 2; // reader running
+
+	if (in->y4m_flag)
+		printf("Input %s y4m %dx%d %d:%d fps, streamed\n", filename, in->width, in->height, in->fps_num, in->fps_den);
+	else
+		printf("Input %s %dx%d stride %d, streamed\n", filename, in->width, in->height, in->stride_y);
+	return(0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Open a planar 4:2:0 input: a regular raw file is memory mapped, "-" (stdin), pipes and y4m files (probed)
+// are streamed by a reader thread, "shm:/name" attaches to a capture process frame ring. Width and height are the raw picture size, a y4m header overrides them.
+int gg_input_open(YuvInput* in, const char* filename, int width, int height, int stride, int format)
+{
+	int ret;
+
+	memset(in, 0, sizeof(YuvInput));
+	input_format(in, width, height, stride, format);
+#ifdef _WIN32
+	in->file = INVALID_HANDLE_VALUE;
+#else
+	in->fd = -1;
+#endif
+	if (stride && stride < width) {
+		printf("ERROR: input stride %d is less than the width %d\n", stride, width);
+		return(-1);
+	}
+
+	if (!strncmp(filename, "shm:", 4)) {
+		ShmRingHdr* hdr;
+		if (gg_shm_attach(&in->shm, filename + 4))
+			return(-1);
+		hdr = in->shm.hdr;
+		in->shm_flag = 1;
+		input_format(in, hdr->width, hdr->height, hdr->stride_y, hdr->format);
+		in->fps_num = hdr->fps_num;
+		in->fps_den = hdr->fps_den;
+		printf("Input %s %dx%d stride %d, %d slot shared memory ring\n", filename + 4, in->width, in->height, in->stride_y, hdr->num_slots);
+		return(0);
+	}
+	if (!strcmp(filename, "-")) {
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		in->fp = stdin;
+		return(input_stream_open(in, "stdin"));
+	}
+	ret = input_map_open(in, filename);
+	if (ret <= 0)
+		return(ret);
+	in->fp = fopen(filename, "rb");
+	if (!in->fp) {
+		printf("ERROR: could not open input %s\n", filename);
+		return(-1);
+	}
+	return(input_stream_open(in, filename));
+}
+
+// Return the buffer held by the encoder to the reader, lock held
+static void input_stream_release(YuvInput* in)
+{
+	if (in->held >= 0) {
+		in->slot[in->held].state = GG_SLOT_FREE;
+		in->slot[in->held].rows = 0;
+		in->held = -1;
+		gg_cond_broadcast(&in->cond);
+	}
+}
+
+// Get the next picture, returns -1 at end of file
+// Mapped input points into the mapping, streamed input hands over the next filled buffer
+// and returns the previous one to the reader.
+int gg_input_read(YuvInput* in, YuvFrame* frame)
+{
+	if (in->shm_flag) {
+		unsigned char* p = gg_shm_acquire(&in->shm);
+		if (!p)
+			return(-1);
+		input_frame_ptrs(in, frame, p);
+		in->frame_idx++;
+		return(0);
+	}
+	if (in->stream_flag) {
+		YuvSlot* slot = &in->slot[in->rd_idx];
+		gg_mutex_lock(&in->lock);
+		input_stream_release(in);
+		if (slot->state == GG_SLOT_FREE) {
+			in->num_waits++;
+			while (slot->state == GG_SLOT_FREE && !(in->raster_flag && in->eos))
+				gg_cond_wait(&in->cond, &in->lock);
+		}
+		if (slot->state != GG_SLOT_READY) {
+			gg_mutex_unlock(&in->lock);
+			return(-1);
+		}
+		in->held = in->rd_idx;
+		in->rd_idx = (in->rd_idx + 1) % GG_INPUT_POOL;
+		gg_mutex_unlock(&in->lock);
+		*frame = slot->frame;
+		in->frame_idx++;
+		return(0);
+	}
+
+	if (in->frame_idx >= in->num_frames)
+		return(-1);
+	input_frame_ptrs(in, frame, in->map + in->frame_idx * in->frame_size);
+	in->frame_idx++;
+
+#ifndef _WIN32
+	// start paging in the following frame while this one is encoded
+	if (in->frame_idx < in->num_frames) {
+		long long page = sysconf(_SC_PAGESIZE);
+		long long ofs = (in->frame_idx * in->frame_size) & ~(page - 1);
+		long long len = in->frame_size + page;
+		madvise(in->map + ofs, (ofs + len > in->map_len) ? in->map_len - ofs : len, MADV_WILLNEED);
+	}
+#endif
+	return(0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Raster input, the capture side pushes macroblock row strips and the encoder
+// starts on a picture as soon as its first strip is in
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+int gg_input_open_raster(YuvInput* in, int width, int height)
+{
+	memset(in, 0, sizeof(YuvInput));
+	input_format(in, width, height, 0, GG_YUV_I420);
+#ifdef _WIN32
+	in->file = INVALID_HANDLE_VALUE;
+#else
+	in->fd = -1;
+#endif
+	if (input_pool_init(in))
+		return(-1);
+	in->stream_flag = 1;
+	in->raster_flag = 1;
+	printf("Input raster %dx%d, macroblock row strips\n", width, height);
+	return(0);
+}
+
+// Append lines (a multiple of 16, or the rest of the picture) to the picture being captured,
+// with the matching lines/2 of each chroma plane. Waits for a free buffer at the start of a picture.
+// Returns -1 once the input is stopped.
+// chroma_step 2 takes interleaved (NV12) chroma with cr = cb + 1, the strip is stored planar.
+int gg_input_push_rows(YuvInput* in, const char* y, const char* cb, const char* cr, int stride_y, int stride_c, int chroma_step, int lines)
+{
+	YuvSlot* slot = &in->slot[in->wr_idx];
+	int ly = in->wr_rows * 16;
+	int lc = in->wr_rows * 8;
+
+	if (in->wr_rows == 0) {
+		gg_mutex_lock(&in->lock);
+		while (slot->state != GG_SLOT_FREE && !in->stop)
+			gg_cond_wait(&in->cond, &in->lock);
+		gg_mutex_unlock(&in->lock);
+	}
+	if (in->stop)
+		return(-1);
+	if (ly + lines > in->height)
+		lines = in->height - ly;
+
+	// Copy the strip outside the lock, the encoder only reads rows below slot->rows
+	for (int ii = 0; ii < lines; ii++)
+		memcpy(slot->frame.y + (long long)(ly + ii) * in->stride_y, y + (long long)ii * stride_y, in->width);
+	for (int ii = 0; ii < (lines >> 1); ii++) {
+		char* dcb = slot->frame.cb + (long long)(lc + ii) * in->stride_c;
+		char* dcr = slot->frame.cr + (long long)(lc + ii) * in->stride_c;
+		const char* scb = cb + (long long)ii * stride_c;
+		const char* scr = cr + (long long)ii * stride_c;
+		if (chroma_step == 1) {
+			memcpy(dcb, scb, in->width >> 1);
+			memcpy(dcr, scr, in->width >> 1);
+		}
+		else {
+			for (int xx = 0; xx < (in->width >> 1); xx++) {
+				dcb[xx] = scb[xx * chroma_step];
+				dcr[xx] = scr[xx * chroma_step];
+			}
+		}
+	}
+
+	in->wr_rows += (lines + 15) >> 4;
+	gg_mutex_lock(&in->lock);
+	slot->rows = in->wr_rows;
+	slot->state = GG_SLOT_READY;
+	if (in->wr_rows >= in->mb_rows) {
+		in->wr_idx = (in->wr_idx + 1) % GG_INPUT_POOL;
+		in->wr_rows = 0;
+	}
+	gg_cond_broadcast(&in->cond);
+	gg_mutex_unlock(&in->lock);
+	return(0);
+}
+
+// End of capture, a partly pushed picture is coded with whatever its remaining rows hold
+void gg_input_push_end(YuvInput* in)
+{
+	gg_mutex_lock(&in->lock);
+	if (in->wr_rows)
+		in->slot[in->wr_idx].rows = in->mb_rows;
+	in->eos = 1;
+	gg_cond_broadcast(&in->cond);
+	gg_mutex_unlock(&in->lock);
+}
+
+// Stop the input, wakes a producer waiting in gg_input_push_rows
+void gg_input_stop(YuvInput* in)
+{
+	if (in->lock_flag) {
+		gg_mutex_lock(&in->lock);
+		in->stop = 1;
+		gg_cond_broadcast(&in->cond);
+		gg_mutex_unlock(&in->lock);
+	}
+}
+
+// Macroblock over the right or bottom picture edge, the last column and row are repeated
+static void input_load_edge_mb(const YuvFrame* frame, int mbx, int mby, unsigned char* y, unsigned char* cb, unsigned char* cr)
+{
+	int wc = frame->width >> 1;
+	int hc = frame->height >> 1;
+	for (int py = 0; py < 16; py++) {
+		int sy = (mby * 16 + py < frame->height) ? mby * 16 + py : frame->height - 1;
+		const unsigned char* row = (const unsigned char*)frame->y + (long long)sy * frame->stride_y;
+		for (int px = 0; px < 16; px++)
+			y[py * 16 + px] = row[(mbx * 16 + px < frame->width) ? mbx * 16 + px : frame->width - 1];
+	}
+	for (int py = 0; py < 8; py++) {
+		int sy = (mby * 8 + py < hc) ? mby * 8 + py : hc - 1;
+		const unsigned char* rcb = (const unsigned char*)frame->cb + (long long)sy * frame->stride_c;
+		const unsigned char* rcr = (const unsigned char*)frame->cr + (long long)sy * frame->stride_c;
+		for (int px = 0; px < 8; px++) {
+			int sx = ((mbx * 8 + px < wc) ? mbx * 8 + px : wc - 1) * frame->chroma_step;
+			cb[py * 8 + px] = rcb[sx];
+			cr[py * 8 + px] = rcr[sx];
+		}
+	}
+}
+
+// Gather one macroblock of source samples straight from the input frame: 16x16 luma
+// and 8x8 cb, cr, packed. Interleaved chroma is split here so NV12 is never repacked.
+// Edge macroblocks of pictures that are not a macroblock multiple are padded here, not in the frame.
+void gg_input_load_mb(const YuvFrame* frame, int mbx, int mby, unsigned char* y, unsigned char* cb, unsigned char* cr)
+{
+	if (mbx * 16 + 16 > frame->width || mby * 16 + 16 > frame->height) {
+		input_load_edge_mb(frame, mbx, mby, y, cb, cr);
+		return;
+	}
+
+	const unsigned char* sy = (const unsigned char*)frame->y + (long long)mby * 16 * frame->stride_y + mbx * 16;
+	const unsigned char* scb = (const unsigned char*)frame->cb + (long long)mby * 8 * frame->stride_c + mbx * 8 * frame->chroma_step;
+	const unsigned char* scr = (const unsigned char*)frame->cr + (long long)mby * 8 * frame->stride_c + mbx * 8 * frame->chroma_step;
+
+	for (int ii = 0; ii < 16; ii++)
+		memcpy(y + ii * 16, sy + (long long)ii * frame->stride_y, 16);
+	if (frame->chroma_step == 1) {
+		for (int ii = 0; ii < 8; ii++) {
+			memcpy(cb + ii * 8, scb + (long long)ii * frame->stride_c, 8);
+			memcpy(cr + ii * 8, scr + (long long)ii * frame->stride_c, 8);
+		}
+		return;
+	}
+#ifdef GG_INPUT_SSE2
+	{
+		const __m128i mask = _mm_set1_epi16(0x00ff);
+		for (int ii = 0; ii < 8; ii++) {
+			__m128i uv = _mm_loadu_si128((const __m128i*)(scb + (long long)ii * frame->stride_c));
+			__m128i uu = _mm_and_si128(uv, mask);
+			__m128i vv = _mm_srli_epi16(uv, 8);
+			__m128i pk = _mm_packus_epi16(uu, vv); // cb in the low 8 bytes, cr in the high 8
+			_mm_storel_epi64((__m128i*)(cb + ii * 8), pk);
+			_mm_storel_epi64((__m128i*)(cr + ii * 8), _mm_srli_si128(pk, 8));
+		}
+	}
+#else
+	for (int ii = 0; ii < 8; ii++) {
+		for (int xx = 0; xx < 8; xx++) {
+			cb[ii * 8 + xx] = scb[(long long)ii * frame->stride_c + xx * 2];
+			cr[ii * 8 + xx] = scr[(long long)ii * frame->stride_c + xx * 2];
+		}
+	}
+#endif
+}
+
+// Wait until macroblock row mb_row of the current picture has arrived, immediate unless raster input
+void gg_input_wait_row(YuvInput* in, int mb_row)
+{
+	YuvSlot* slot;
+	if (!in->raster_flag || in->held < 0)
+		return;
+	slot = &in->slot[in->held];
+	gg_mutex_lock(&in->lock);
+	if (slot->rows <= mb_row) {
+		in->num_row_waits++;
+		while (slot->rows <= mb_row)
+			gg_cond_wait(&in->cond, &in->lock);
+	}
+	gg_mutex_unlock(&in->lock);
+}
+
+// The encoder has read its last samples from macroblock row mb_row of the current picture
+// After the last row the frame goes straight back to the producer, before recon output and ref copies
+void gg_input_row_done(YuvInput* in, int mb_row)
+{
+	if (mb_row < ((in->height + 15) >> 4) - 1)
+		return;
+	if (in->shm_flag) {
+		gg_shm_release(&in->shm);
+	}
+	else if (in->stream_flag) {
+		gg_mutex_lock(&in->lock);
+		input_stream_release(in);
+		gg_mutex_unlock(&in->lock);
+	}
+}
+
+void gg_input_close(YuvInput* in)
+{
+	if (in->shm_flag) {
+		printf("Input: %d frames, %d capture frames skipped, encoder waited on the capture %d times\n", in->shm.num_frames, in->shm.num_gaps, in->shm.num_waits);
+		gg_shm_close(&in->shm);
+		in->shm_flag = 0;
+	}
+	if (in->lock_flag) {
+		gg_input_stop(in);
+		if (in->stream_flag == 2)
+			gg_thread_join(in->thread);
+		gg_cond_destroy(&in->cond);
+		gg_mutex_destroy(&in->lock);
+		in->lock_flag = 0;
+		if (in->raster_flag)
+			printf("Input: %lld frames, encoder waited on a picture %d times, on a row strip %d times\n", in->frame_idx, in->num_waits, in->num_row_waits);
+		else
+			printf("Input: %lld frames, encoder waited on the reader %d times\n", in->frame_idx, in->num_waits);
+	}
+	for (int ii = 0; ii < GG_INPUT_POOL; ii++) {
+		if (in->slot[ii].buf)
+			gg_free(in->slot[ii].buf);
+		in->slot[ii].buf = NULL;
+	}
+	if (in->fp && in->fp != stdin)
+		fclose(in->fp);
+	in->fp = NULL;
+	in->stream_flag = 0;
+
+	input_map_close(in);
+}
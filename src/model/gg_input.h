@@ -0,0 +1,98 @@
+#pragma once
+
+#include "gg_thread.h"
+#include "gg_shm.h"
+
+#define GG_INPUT_POOL 3 // frame buffers the reader thread fills ahead of the encoder
+
+// 4:2:0 input picture, plane pointers point straight into the input buffers (no copy)
+typedef struct _YuvFrame {
+	char* y;
+	char* cb;
+	char* cr;
+	int stride_y; // bytes between luma rows
+	int stride_c; // bytes between chroma rows
+	int chroma_step; // bytes between chroma samples, 1 planar, 2 interleaved (NV12: cr = cb + 1)
+	int width; // luma samples present, need not be a macroblock multiple
+	int height;
+} YuvFrame;
+
+// Stream buffer states
+#define GG_SLOT_FREE  0
+#define GG_SLOT_READY 1 // filled, waiting for the encoder
+#define GG_SLOT_EOS   2 // end of stream marker
+
+typedef struct _YuvSlot {
+	unsigned char* buf; // aligned planes
+	YuvFrame frame;
+	int state;
+	int rows; // macroblock rows filled
+} YuvSlot;
+
+typedef struct _YuvInput {
+
+	// Picture format
+	int width; // luma samples
+	int height;
+	int stride_y; // row pitch in the file
+	int stride_c;
+	int format; // GG_YUV_I420 or GG_YUV_NV12
+	long long frame_size; // bytes per frame in the file
+	int fps_num; // frame rate, 0 if unknown
+	int fps_den;
+
+	// Memory mapped planar yuv file
+	unsigned char* map;
+	long long map_len;
+	long long num_frames;
+	long long frame_idx; // next frame to read
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int fd;
+#endif
+
+	// Streamed input (stdin, pipes, y4m), read ahead by a thread into a buffer pool
+	int stream_flag;
+	int y4m_flag;
+	FILE* fp;
+	unsigned char peek[16]; // bytes read while probing for a y4m header
+	int peek_len;
+	int peek_pos;
+	gg_thread_t thread;
+	gg_mutex_t lock;
+	gg_cond_t cond;
+	YuvSlot slot[GG_INPUT_POOL];
+	int lock_flag; // pool lock initialized
+	int mb_rows;
+	int rd_idx; // next slot for the encoder
+	int wr_idx; // slot being filled by the raster producer
+	int wr_rows; // macroblock rows pushed into it
+	int held; // slot in use by the encoder, -1 if none
+	int stop;
+	int num_waits; // times the encoder had to wait on the reader
+
+	// Raster input, pictures pushed in macroblock row strips
+	int raster_flag;
+	int eos;
+	int num_row_waits; // times the encoder waited on a strip
+
+	// Shared memory ring from a capture process ("shm:/name"), coded in place
+	int shm_flag;
+	ShmRing shm;
+
+} YuvInput;
+
+int gg_input_open(YuvInput* in, const char* filename, int width, int height, int stride, int format);
+void gg_input_load_mb(const YuvFrame* frame, int mbx, int mby, unsigned char* y, unsigned char* cb, unsigned char* cr);
+int gg_input_read(YuvInput* in, YuvFrame* frame);
+void gg_input_wait_row(YuvInput* in, int mb_row);
+void gg_input_row_done(YuvInput* in, int mb_row);
+void gg_input_stop(YuvInput* in);
+void gg_input_close(YuvInput* in);
+
+// Raster producer side
+int gg_input_open_raster(YuvInput* in, int width, int height);
+int gg_input_push_rows(YuvInput* in, const char* y, const char* cb, const char* cr, int stride_y, int stride_c, int chroma_step, int lines);
+void gg_input_push_end(YuvInput* in);
@@ -138,9 +138,9 @@ int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char*
 		// Decode syntax_element to get { num_coeff, trailing_ones }
 		coeff_token_bitword >>= (32 - coeff_token_length); // right hand justify for comparison
 		for (int ii = 0; ii < ((coeff_table_idx == 4) ? 14 : 62); ii++) { // TODO: can optimize this much further
-			if (coeff_token_bitword == coeff_token_parse_table[coeff_table_idx][ii][0] && coeff_token_length == coeff_token_parse_table[coeff_table_idx][ii][1]) {
-				num_coeff = coeff_token_parse_table[coeff_table_idx][ii][3];
-				trailing_ones = coeff_token_parse_table[coeff_table_idx][ii][2];
+			if (coeff_token_bitword == gg_cavld.coeff_token[coeff_table_idx][ii][0] && coeff_token_length == gg_cavld.coeff_token[coeff_table_idx][ii][1]) {
+				num_coeff = gg_cavld.coeff_token[coeff_table_idx][ii][3];
+				trailing_ones = gg_cavld.coeff_token[coeff_table_idx][ii][2];
 				break;
 			}
 		}
@@ -278,8 +278,8 @@ int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char*
 		// Decode total_zeros syntax_element }
 		total_zeros_bitword >>= (32 - total_zeros_length); // right hand justify for comparison
 		for (int ii = 0; ii < (((ch_flag && dc_flag) ? 4 : 16) - num_coeff + 1); ii++) { // TODO: can optimize this much further
-			if (total_zeros_bitword == total_zeros_parse_table[total_zeros_table_idx][ii][0] && total_zeros_length == total_zeros_parse_table[total_zeros_table_idx][ii][1]) {
-				total_zeros = total_zeros_parse_table[total_zeros_table_idx][ii][2];
+			if (total_zeros_bitword == gg_cavld.total_zeros[total_zeros_table_idx][ii][0] && total_zeros_length == gg_cavld.total_zeros[total_zeros_table_idx][ii][1]) {
+				total_zeros = gg_cavld.total_zeros[total_zeros_table_idx][ii][2];
 				break;
 			}
 		}
@@ -319,8 +319,8 @@ int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char*
 			// Decode run_before
 			run_before_bitword >>= (32 - run_before_length); // right hand justify for comparison
 			for (int ii = 0; ii < ((run_before_table_idx<6)?(run_before_table_idx+2):15); ii++) { // TODO: can optimize this much further
-				if (run_before_bitword == run_before_parse_table[run_before_table_idx][ii][0] && run_before_length == run_before_parse_table[run_before_table_idx][ii][1]) {
-					run_before[run_idx] = run_before_parse_table[run_before_table_idx][ii][2];
+				if (run_before_bitword == gg_cavld.run_before[run_before_table_idx][ii][0] && run_before_length == gg_cavld.run_before[run_before_table_idx][ii][1]) {
+					run_before[run_idx] = gg_cavld.run_before[run_before_table_idx][ii][2];
 					break;
 				}
 			}
@@ -400,7 +400,7 @@ int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char*
 	int coeff_dc;
 
 	// Select qpy or derive qpc
-	qp = (ch_flag) ? qpc_table[qpy] : qpy;
+	qp = (ch_flag) ? gg_quant.qpc[qpy] : qpy;
 
 	if (dc_flag) { // Just copy DC coeff, will be quanted later along with AC
 		if (ch_flag) { // sub-sample coeffs for ch dc
@@ -419,12 +419,12 @@ int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char*
 	else { // Inverse quant 4x4, with special scaling for DC coeff when appropriate
 		for (int ii = 0; ii < 16; ii++) {
 			if (ii == 0 && ac_flag && ch_flag) { // Handle Chroma dc coeff
-				dequant = 16 * Dmat[qp % 6][0][0];
+				dequant = 16 * gg_quant.dmat[qp % 6][0][0];
 				coeff_dc = dc_hold[((bidx & 1) << 0) + ((bidx & 2) << 1)]; // sample 0,1,4,5
 				f[0] = ((coeff_dc * dequant) << (qp / 6)) >> 5;
 			}
 			else if (ii == 0 && ac_flag) { // Intra 16 dc coeff
-				dequant = 16 * Dmat[qp % 6][0][0];
+				dequant = 16 * gg_quant.dmat[qp % 6][0][0];
 				coeff_dc = dc_hold[((bidx & 1) << 0) + ((bidx & 2) << 1) + ((bidx & 4) >> 1) + ((bidx & 8) << 0)];
 				if (qp >= 36) {
 					f[0] = (coeff_dc * dequant) << (qp / 6 - 6);
@@ -434,7 +434,7 @@ int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char*
 				}
 			}
 			else { // normal 4x4 quant
-				dequant = 16 * Dmat[qp % 6][ii >> 2][ii & 3];
+				dequant = 16 * gg_quant.dmat[qp % 6][ii >> 2][ii & 3];
 				if (qp >= 24) {
 					f[ii] = (coeff[ii] * dequant) << (qp / 6 - 4);
 				}
@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ME_HAVE_SSE2 1
+#endif
+#include "gg_process.h"
+#include "gg_dist.h"
+#include "gg_me.h"
+
+// Motion cost weight per mvd bit, by qp (about 2^((qp-12)/6), SAD domain)
+static const unsigned char me_lambda[52] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	2, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 6, 6, 7, 8, 9,
+	10, 11, 13, 14, 16, 18, 20, 23, 25, 29, 32, 36, 40, 45, 51, 57,
+	64, 72, 81, 91
+};
+
+int gg_me_open(MeCtx* me, int mb_width, int mb_height, int range, int subpel, int pyramid)
+{
+	memset(me, 0, sizeof(MeCtx));
+	me->mb_width = mb_width;
+	me->mb_height = mb_height;
+	me->range = CLIP3(0, GG_ME_MAX_RANGE, range);
+	me->subpel = subpel;
+	me->pyramid = pyramid;
+	me->early_sad = 256; // one per sample
+	me->mbm = (MbMotion*)calloc((size_t)mb_width * mb_height, sizeof(MbMotion));
+	if (subpel)
+		me->hpel_tmp = (short*)malloc((size_t)21 * mb_width * 16 * sizeof(short));
+	if (pyramid) {
+		me->low[0] = (unsigned char*)malloc((size_t)mb_width * 8 * mb_height * 8);
+		me->low[1] = (unsigned char*)malloc((size_t)mb_width * 4 * mb_height * 4);
+	}
+	if (!me->mbm || (subpel && !me->hpel_tmp) || (pyramid && (!me->low[0] || !me->low[1]))) {
+		printf("ERROR: out of memory for motion vectors\n");
+		return(-1);
+	}
+	return(0);
+}
+
+void gg_me_close(MeCtx* me)
+{
+	if (me->num_mb)
+		printf("Motion: %lld macroblocks searched, %.1f SADs each, %.1f downsampled SADs each, %.1f sub sample SATDs each, %lld stopped at a predictor, %lld seeded by the pyramid, %lld moved\n",
+			me->num_mb, (double)me->num_sad / me->num_mb, (double)me->num_low / me->num_mb, (double)me->num_satd / me->num_mb, me->num_early, me->num_pyramid, me->num_moved);
+	free(me->mbm);
+	free(me->hpel_tmp);
+	free(me->low[0]);
+	free(me->low[1]);
+	me->mbm = NULL;
+	me->hpel_tmp = NULL;
+	me->low[0] = me->low[1] = NULL;
+}
+
+void gg_me_init_slice(MeCtx* me, int first_mb)
+{
+	me->first_mb = first_mb;
+}
+
+void gg_me_set_mb(MeCtx* me, int mbx, int mby, int refidx, int mvx, int mvy)
+{
+	MbMotion* m = &me->mbm[mby * me->mb_width + mbx];
+	m->refidx = (signed char)refidx;
+	m->mvx = (short)((refidx < 0) ? 0 : mvx);
+	m->mvy = (short)((refidx < 0) ? 0 : mvy);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Motion vector prediction
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Neighbour at (dx, dy), returns 0 if outside the picture or the slice. Intra neighbours are available with refidx -1, mv 0
+static int me_nb(const MeCtx* me, int mbx, int mby, int dx, int dy, MbMotion* m)
+{
+	int x = mbx + dx;
+	int y = mby + dy;
+	m->mvx = m->mvy = 0;
+	m->refidx = -1;
+	if (x < 0 || x >= me->mb_width || y < 0 || y * me->mb_width + x < me->first_mb)
+		return(0);
+	*m = me->mbm[y * me->mb_width + x];
+	return(1);
+}
+
+static int median3(int a, int b, int c)
+{
+	return(MAX(MIN(a, b), MIN(MAX(a, b), c)));
+}
+
+// 8.4.1.3 for a 16x16 partition
+void gg_me_pred_mv(const MeCtx* me, int mbx, int mby, int refidx, int* mvx, int* mvy)
+{
+	MbMotion a, b, c;
+	int avail_a = me_nb(me, mbx, mby, -1, 0, &a);
+	int avail_b = me_nb(me, mbx, mby, 0, -1, &b);
+	int avail_c = me_nb(me, mbx, mby, 1, -1, &c);
+	int match;
+
+	if (!avail_c) // D stands in for C
+		avail_c = me_nb(me, mbx, mby, -1, -1, &c);
+	if (!avail_b && !avail_c && avail_a) {
+		b = a;
+		c = a;
+	}
+	match = ((a.refidx == refidx) ? 1 : 0) + ((b.refidx == refidx) ? 2 : 0) + ((c.refidx == refidx) ? 4 : 0);
+	if (match == 1 || match == 2 || match == 4) { // only one neighbour uses the same reference
+		const MbMotion* m = (match == 1) ? &a : (match == 2) ? &b : &c;
+		*mvx = m->mvx;
+		*mvy = m->mvy;
+		return;
+	}
+	*mvx = median3(a.mvx, b.mvx, c.mvx);
+	*mvy = median3(a.mvy, b.mvy, c.mvy);
+}
+
+// 8.4.1.1, zero at the slice top or left edge or when A or B is a still refidx 0 macroblock
+void gg_me_skip_mv(const MeCtx* me, int mbx, int mby, int* mvx, int* mvy)
+{
+	MbMotion a, b;
+	*mvx = *mvy = 0;
+	if (!me_nb(me, mbx, mby, -1, 0, &a) || !me_nb(me, mbx, mby, 0, -1, &b))
+		return;
+	if ((a.refidx == 0 && !a.mvx && !a.mvy) || (b.refidx == 0 && !b.mvx && !b.mvy))
+		return;
+	gg_me_pred_mv(me, mbx, mby, 0, mvx, mvy);
+}
+
+int gg_me_mv_ok(const MeCtx* me, int mbx, int mby, int mvx, int mvy)
+{
+	int x = mbx * 16 + (mvx >> 2);
+	int y = mby * 16 + (mvy >> 2);
+	if (!me->subpel && ((mvx & 3) || (mvy & 3))) // integer positions only
+		return(0);
+	if (mvx & 3) // quarter samples may read the next integer column
+		x++;
+	if (mvy & 3)
+		y++;
+	return(x >= 0 && y >= 0 && x <= (me->mb_width - 1) * 16 && y <= (me->mb_height - 1) * 16);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Interpolation
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// Replicate the edge samples of rows y0..y1-1 into 3 border columns each side, and past the picture top and
+// bottom into 3 border rows, so the 6 tap filter reads the clipped reference samples of 8.4.2.2.1 unclamped
+static void me_extend_rows(unsigned char* p, int stride, int width, int height, int y0, int y1)
+{
+	for (int yy = MAX(y0, 0); yy < MIN(y1, height); yy++) {
+		unsigned char* row = p + yy * stride;
+		for (int xx = 1; xx <= 3; xx++) {
+			row[-xx] = row[0];
+			row[width - 1 + xx] = row[width - 1];
+		}
+	}
+	if (y0 <= 0)
+		for (int yy = 1; yy <= 3; yy++)
+			memcpy(p - yy * stride - 3, p - 3, width + 6);
+	if (y1 >= height)
+		for (int yy = 1; yy <= 3; yy++)
+			memcpy(p + (height - 1 + yy) * stride - 3, p + (height - 1) * stride - 3, width + 6);
+}
+
+#define ME_TAP6(a, b, c, d, e, f) ((a) + (f) - 5 * ((b) + (e)) + 20 * ((c) + (d)))
+
+// Horizontal intermediates b1 of one row, and the rounded half samples b when wanted
+static void me_hpel_row_h(const unsigned char* src, short* b1, unsigned char* b, int width)
+{
+	for (int xx = 0; xx < width; xx++) {
+		b1[xx] = (short)ME_TAP6(src[xx - 2], src[xx - 1], src[xx], src[xx + 1], src[xx + 2], src[xx + 3]);
+		if (b)
+			b[xx] = (unsigned char)CLIP3(0, 255, (b1[xx] + 16) >> 5);
+	}
+}
+
+// Vertical half samples h from 6 integer rows, and centre samples j from 6 rows of horizontal intermediates
+static void me_hpel_row_v(const unsigned char* src, int stride, const short* b1, int pitch, unsigned char* h, unsigned char* j, int width)
+{
+	for (int xx = 0; xx < width; xx++) {
+		const unsigned char* s = &src[xx];
+		const short* t = &b1[xx];
+		h[xx] = (unsigned char)CLIP3(0, 255, (ME_TAP6(s[-2 * stride], s[-stride], s[0], s[stride], s[2 * stride], s[3 * stride]) + 16) >> 5);
+		j[xx] = (unsigned char)CLIP3(0, 255, (ME_TAP6(t[0], t[pitch], t[2 * pitch], t[3 * pitch], t[4 * pitch], t[5 * pitch]) + 512) >> 10);
+	}
+}
+
+#ifdef ME_HAVE_SSE2
+// Intermediates fit 16 bits: -2550..10710
+static __m128i me_tap6_epi16(__m128i a, __m128i b, __m128i c, __m128i d, __m128i e, __m128i f)
+{
+	__m128i sum = _mm_sub_epi16(_mm_add_epi16(a, f), _mm_mullo_epi16(_mm_add_epi16(b, e), _mm_set1_epi16(5)));
+	return(_mm_add_epi16(sum, _mm_mullo_epi16(_mm_add_epi16(c, d), _mm_set1_epi16(20))));
+}
+
+static __m128i me_load8(const unsigned char* p)
+{
+	return(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()));
+}
+
+static void me_hpel_row_h_sse2(const unsigned char* src, short* b1, unsigned char* b, int width)
+{
+	for (int xx = 0; xx < width; xx += 8) {
+		const unsigned char* s = &src[xx];
+		__m128i t = me_tap6_epi16(me_load8(s - 2), me_load8(s - 1), me_load8(s), me_load8(s + 1), me_load8(s + 2), me_load8(s + 3));
+		_mm_storeu_si128((__m128i*)&b1[xx], t);
+		if (b) {
+			t = _mm_srai_epi16(_mm_add_epi16(t, _mm_set1_epi16(16)), 5);
+			_mm_storel_epi64((__m128i*)&b[xx], _mm_packus_epi16(t, t));
+		}
+	}
+}
+
+// j needs 32 bits: pairs of the symmetric tap sums go through madd as (s05, s14) * (1, -5) and (s23, 0) * (20, 0)
+static void me_hpel_row_v_sse2(const unsigned char* src, int stride, const short* b1, int pitch, unsigned char* h, unsigned char* j, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i k15 = _mm_setr_epi16(1, -5, 1, -5, 1, -5, 1, -5);
+	const __m128i k20 = _mm_setr_epi16(20, 0, 20, 0, 20, 0, 20, 0);
+	const __m128i r512 = _mm_set1_epi32(512);
+	for (int xx = 0; xx < width; xx += 8) {
+		const unsigned char* s = &src[xx];
+		const short* t = &b1[xx];
+		__m128i v = me_tap6_epi16(me_load8(s - 2 * stride), me_load8(s - stride), me_load8(s), me_load8(s + stride), me_load8(s + 2 * stride), me_load8(s + 3 * stride));
+		__m128i s05 = _mm_add_epi16(_mm_loadu_si128((const __m128i*)t), _mm_loadu_si128((const __m128i*)&t[5 * pitch]));
+		__m128i s14 = _mm_add_epi16(_mm_loadu_si128((const __m128i*)&t[pitch]), _mm_loadu_si128((const __m128i*)&t[4 * pitch]));
+		__m128i s23 = _mm_add_epi16(_mm_loadu_si128((const __m128i*)&t[2 * pitch]), _mm_loadu_si128((const __m128i*)&t[3 * pitch]));
+		__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(s05, s14), k15), _mm_madd_epi16(_mm_unpacklo_epi16(s23, zero), k20));
+		__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(s05, s14), k15), _mm_madd_epi16(_mm_unpackhi_epi16(s23, zero), k20));
+		v = _mm_srai_epi16(_mm_add_epi16(v, _mm_set1_epi16(16)), 5);
+		_mm_storel_epi64((__m128i*)&h[xx], _mm_packus_epi16(v, v));
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, r512), 10);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, r512), 10);
+		lo = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)&j[xx], _mm_packus_epi16(lo, lo));
+	}
+}
+#endif
+
+void gg_me_hpel_rows(MeCtx* me, RefPic* pic, int stride_y, int mb_rows)
+{
+	int width = me->mb_width * 16;
+	int height = me->mb_height * 16;
+	unsigned char* y = (unsigned char*)pic->y;
+#ifdef ME_HAVE_SSE2
+	int sse2 = (gg_dist.level >= GG_DIST_SSE2);
+#endif
+
+	for (mb_rows = MIN(mb_rows, me->mb_height); pic->hpel_rows < mb_rows; pic->hpel_rows++) {
+		int y0 = pic->hpel_rows * 16;
+		me_extend_rows(y, stride_y, width, height, y0, y0 + 19);
+		// b1 of rows y0-2 .. y0+18, b of the band rows
+		for (int yy = y0 - 2; yy < y0 + 19; yy++) {
+			short* b1 = &me->hpel_tmp[(yy - y0 + 2) * width];
+			unsigned char* b = (yy >= y0 && yy < y0 + 16) ? (unsigned char*)pic->hpel[0] + yy * stride_y : NULL;
+#ifdef ME_HAVE_SSE2
+			if (sse2) {
+				me_hpel_row_h_sse2(y + yy * stride_y, b1, b, width);
+				continue;
+			}
+#endif
+			me_hpel_row_h(y + yy * stride_y, b1, b, width);
+		}
+		for (int yy = y0; yy < y0 + 16; yy++) {
+			const short* b1 = &me->hpel_tmp[(yy - y0) * width];
+			unsigned char* h = (unsigned char*)pic->hpel[1] + yy * stride_y;
+			unsigned char* j = (unsigned char*)pic->hpel[2] + yy * stride_y;
+#ifdef ME_HAVE_SSE2
+			if (sse2) {
+				me_hpel_row_v_sse2(y + yy * stride_y, stride_y, b1, width, h, j, width);
+				continue;
+			}
+#endif
+			me_hpel_row_v(y + yy * stride_y, stride_y, b1, width, h, j, width);
+		}
+	}
+}
+
+// One downsampled row from two source rows, width output samples: vertical then horizontal rounded averages
+static void me_down_row(const unsigned char* r0, const unsigned char* r1, unsigned char* dst, int width)
+{
+	int xx = 0;
+#ifdef ME_HAVE_SSE2
+	if (gg_dist.level >= GG_DIST_SSE2)
+		for (; xx + 8 <= width; xx += 8) {
+			__m128i v = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)&r0[2 * xx]), _mm_loadu_si128((const __m128i*)&r1[2 * xx]));
+			v = _mm_avg_epu16(_mm_and_si128(v, _mm_set1_epi16(0xff)), _mm_srli_epi16(v, 8));
+			_mm_storel_epi64((__m128i*)&dst[xx], _mm_packus_epi16(v, v));
+		}
+#endif
+	for (; xx < width; xx++) {
+		int a = (r0[2 * xx] + r1[2 * xx] + 1) >> 1;
+		int b = (r0[2 * xx + 1] + r1[2 * xx + 1] + 1) >> 1;
+		dst[xx] = (unsigned char)((a + b + 1) >> 1);
+	}
+}
+
+void gg_me_lowres_rows(MeCtx* me, RefPic* pic, int stride_y, int mb_rows)
+{
+	const unsigned char* y = (const unsigned char*)pic->y;
+	unsigned char* l1 = (unsigned char*)pic->low[0];
+	unsigned char* l2 = (unsigned char*)pic->low[1];
+	int p1 = stride_y >> 1;
+	int p2 = stride_y >> 2;
+
+	for (mb_rows = MIN(mb_rows, me->mb_height); pic->low_rows < mb_rows; pic->low_rows++) {
+		for (int yy = pic->low_rows * 8; yy < pic->low_rows * 8 + 8; yy++)
+			me_down_row(y + 2 * yy * stride_y, y + (2 * yy + 1) * stride_y, l1 + yy * p1, me->mb_width * 8);
+		for (int yy = pic->low_rows * 4; yy < pic->low_rows * 4 + 4; yy++)
+			me_down_row(l1 + 2 * yy * p1, l1 + (2 * yy + 1) * p1, l2 + yy * p2, me->mb_width * 4);
+	}
+}
+
+void gg_me_lowres_mb(MeCtx* me, int mbx, int mby, const unsigned char* orig)
+{
+	int p1 = me->mb_width * 8;
+	int p2 = me->mb_width * 4;
+	unsigned char* l1 = me->low[0] + mby * 8 * p1 + mbx * 8;
+	unsigned char* l2 = me->low[1] + mby * 4 * p2 + mbx * 4;
+
+	for (int yy = 0; yy < 8; yy++)
+		me_down_row(orig + 2 * yy * 16, orig + (2 * yy + 1) * 16, l1 + yy * p1, 8);
+	for (int yy = 0; yy < 4; yy++)
+		me_down_row(l1 + 2 * yy * p1, l1 + (2 * yy + 1) * p1, l2 + yy * p2, 4);
+}
+
+// Quarter samples (8.4.2.2.1) are the rounded average of two of the integer plane (0) and the half sample
+// planes (1 x+1/2, 2 y+1/2, 3 both), each one sample right or down or not: plane, dx, dy twice, by yfrac * 4 + xfrac
+static const unsigned char me_qpel_src[16][6] = {
+	{ 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 1, 0, 0 }, { 1, 0, 0, 1, 0, 0 }, { 1, 0, 0, 0, 1, 0 },
+	{ 0, 0, 0, 2, 0, 0 }, { 1, 0, 0, 2, 0, 0 }, { 1, 0, 0, 3, 0, 0 }, { 1, 0, 0, 2, 1, 0 },
+	{ 2, 0, 0, 2, 0, 0 }, { 2, 0, 0, 3, 0, 0 }, { 3, 0, 0, 3, 0, 0 }, { 3, 0, 0, 2, 1, 0 },
+	{ 2, 0, 0, 0, 0, 1 }, { 2, 0, 0, 1, 0, 1 }, { 3, 0, 0, 1, 0, 1 }, { 2, 1, 0, 1, 0, 1 }
+};
+
+// 16x16 prediction at quarter sample position (x, y) of the picture: points into a plane when a single plane
+// has it, otherwise the average goes to tmp (pitch 16)
+static const unsigned char* me_qpel_block(const RefPic* ref, int stride, int x, int y, unsigned char* tmp, int* pitch)
+{
+	const unsigned char* src = me_qpel_src[(y & 3) * 4 + (x & 3)];
+	const unsigned char* a = (const unsigned char*)((src[0]) ? ref->hpel[src[0] - 1] : ref->y) + ((y >> 2) + src[2]) * stride + (x >> 2) + src[1];
+	const unsigned char* b = (const unsigned char*)((src[3]) ? ref->hpel[src[3] - 1] : ref->y) + ((y >> 2) + src[5]) * stride + (x >> 2) + src[4];
+
+	*pitch = stride;
+	if (a == b)
+		return(a);
+	*pitch = 16;
+#ifdef ME_HAVE_SSE2
+	if (gg_dist.level >= GG_DIST_SSE2) {
+		for (int yy = 0; yy < 16; yy++, a += stride, b += stride)
+			_mm_storeu_si128((__m128i*)&tmp[yy * 16], _mm_avg_epu8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+		return(tmp);
+	}
+#endif
+	for (int yy = 0; yy < 16; yy++, a += stride, b += stride)
+		for (int xx = 0; xx < 16; xx++)
+			tmp[yy * 16 + xx] = (unsigned char)((a[xx] + b[xx] + 1) >> 1);
+	return(tmp);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Search
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// se(v) codeword length
+static int me_se_bits(int v)
+{
+	int k = (v > 0) ? 2 * v - 1 : -2 * v;
+	int len = 1;
+	for (k++; k > 1; k >>= 1)
+		len += 2;
+	return(len);
+}
+
+typedef struct _MeSearch {
+	const unsigned char* orig;
+	const unsigned char* ref; // co-located macroblock
+	const RefPic* pic;
+	int stride;
+	int mbx, mby;
+	int xmin, xmax, ymin, ymax; // window, integer luma samples
+	int mvpx, mvpy;
+	int lambda;
+} MeSearch;
+
+// SAD plus the mvd bits, for an integer displacement; -1 outside the window
+static int me_cost(MeCtx* me, const MeSearch* s, int dx, int dy, int* sad)
+{
+	if (dx < s->xmin || dx > s->xmax || dy < s->ymin || dy > s->ymax)
+		return(-1);
+	me->num_sad++;
+	*sad = gg_dist.sad[GG_DIST_16x16](s->orig, 16, s->ref + dy * s->stride + dx, s->stride);
+	return(*sad + s->lambda * (me_se_bits(dx * 4 - s->mvpx) + me_se_bits(dy * 4 - s->mvpy)));
+}
+
+// SATD plus the mvd bits, for a quarter sample mv; -1 outside the window or the picture
+static int me_qcost(MeCtx* me, const MeSearch* s, int mvx, int mvy, int* satd)
+{
+	unsigned char tmp[256];
+	const unsigned char* p;
+	int pitch;
+	if (mvx < s->xmin * 4 || mvx > s->xmax * 4 || mvy < s->ymin * 4 || mvy > s->ymax * 4 || !gg_me_mv_ok(me, s->mbx, s->mby, mvx, mvy))
+		return(-1);
+	me->num_satd++;
+	p = me_qpel_block(s->pic, s->stride, s->mbx * 64 + mvx, s->mby * 64 + mvy, tmp, &pitch);
+	*satd = gg_dist.satd[GG_DIST_16x16](s->orig, 16, p, pitch);
+	return(*satd + s->lambda * (me_se_bits(mvx - s->mvpx) + me_se_bits(mvy - s->mvpy)));
+}
+
+// Coarse to fine seed in integer samples: every position of the window on the 4x level (4x4 blocks), then +-2
+// around it on the 2x level (8x8 blocks). The mvd bits are weighted down by the samples per block of the level.
+static void me_pyramid(MeCtx* me, const MeSearch* s, int* dx, int* dy)
+{
+	int p1 = s->stride >> 1, p2 = s->stride >> 2;
+	int q1 = me->mb_width * 8, q2 = me->mb_width * 4;
+	const unsigned char* o1 = me->low[0] + s->mby * 8 * q1 + s->mbx * 8;
+	const unsigned char* o2 = me->low[1] + s->mby * 4 * q2 + s->mbx * 4;
+	const unsigned char* r1 = (const unsigned char*)s->pic->low[0] + s->mby * 8 * p1 + s->mbx * 8;
+	const unsigned char* r2 = (const unsigned char*)s->pic->low[1] + s->mby * 4 * p2 + s->mbx * 4;
+	int bx = 0, by = 0, bcost = -1, cx, cy;
+
+	for (int y = -((-s->ymin) >> 2); y <= (s->ymax >> 2); y++)
+		for (int x = -((-s->xmin) >> 2); x <= (s->xmax >> 2); x++) {
+			int cost = gg_dist.sad[GG_DIST_4x4](o2, q2, r2 + y * p2 + x, p2);
+			cost += (s->lambda * (me_se_bits(x * 16 - s->mvpx) + me_se_bits(y * 16 - s->mvpy))) >> 4;
+			if (bcost < 0 || cost < bcost) {
+				bcost = cost;
+				bx = x;
+				by = y;
+			}
+		}
+	me->num_low += (long long)((s->ymax >> 2) + ((-s->ymin) >> 2) + 1) * ((s->xmax >> 2) + ((-s->xmin) >> 2) + 1);
+
+	cx = bx * 2;
+	cy = by * 2;
+	bcost = -1;
+	for (int y = MAX(cy - 2, -((-s->ymin) >> 1)); y <= MIN(cy + 2, s->ymax >> 1); y++)
+		for (int x = MAX(cx - 2, -((-s->xmin) >> 1)); x <= MIN(cx + 2, s->xmax >> 1); x++) {
+			int cost = gg_dist.sad[GG_DIST_8x8](o1, q1, r1 + y * p1 + x, p1);
+			cost += (s->lambda * (me_se_bits(x * 8 - s->mvpx) + me_se_bits(y * 8 - s->mvpy))) >> 2;
+			me->num_low++;
+			if (bcost < 0 || cost < bcost) {
+				bcost = cost;
+				bx = x;
+				by = y;
+			}
+		}
+	*dx = bx * 2;
+	*dy = by * 2;
+}
+
+// Rounded to integer samples
+#define ME_INT(v) (((v) + 2) >> 2)
+
+int gg_me_search(MeCtx* me, int mbx, int mby, const unsigned char* orig, const RefPic* ref, int stride_y, int qp, int mvpx, int mvpy, int skipx, int skipy, int* mvx, int* mvy)
+{
+	static const int hex[6][2] = { { -2, 0 }, { -1, -2 }, { 1, -2 }, { 2, 0 }, { 1, 2 }, { -1, 2 } };
+	static const int sqr[8][2] = { { -1, -1 }, { 0, -1 }, { 1, -1 }, { -1, 0 }, { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+	MeSearch s;
+	MbMotion nb[3];
+	int cand[6][2];
+	int num_cand = 0;
+	int bx = 0, by = 0, bcost = -1, bsad = 0;
+	int skip_sad = -1;
+	int cost, sad;
+
+	me->num_mb++;
+	s.orig = orig;
+	s.ref = (const unsigned char*)ref->y + (mby * 16) * stride_y + mbx * 16;
+	s.pic = ref;
+	s.stride = stride_y;
+	s.mbx = mbx;
+	s.mby = mby;
+	s.xmin = MAX(-me->range, -mbx * 16);
+	s.xmax = MIN(me->range, (me->mb_width - 1 - mbx) * 16);
+	s.ymin = MAX(-me->range, -mby * 16);
+	s.ymax = MIN(me->range, (me->mb_height - 1 - mby) * 16);
+	s.mvpx = mvpx;
+	s.mvpy = mvpy;
+	s.lambda = me_lambda[CLIP3(0, 51, qp)];
+
+	// Predictor candidates: skip mv first, then the mv prediction, zero and the neighbours
+	cand[num_cand][0] = ME_INT(skipx); cand[num_cand++][1] = ME_INT(skipy);
+	cand[num_cand][0] = ME_INT(mvpx); cand[num_cand++][1] = ME_INT(mvpy);
+	cand[num_cand][0] = 0; cand[num_cand++][1] = 0;
+	me_nb(me, mbx, mby, -1, 0, &nb[0]);
+	me_nb(me, mbx, mby, 0, -1, &nb[1]);
+	me_nb(me, mbx, mby, 1, -1, &nb[2]);
+	for (int ii = 0; ii < 3; ii++)
+		if (nb[ii].refidx == 0) {
+			cand[num_cand][0] = ME_INT(nb[ii].mvx);
+			cand[num_cand++][1] = ME_INT(nb[ii].mvy);
+		}
+	for (int ii = 0; ii < num_cand; ii++) {
+		int dup = 0;
+		for (int jj = 0; jj < ii; jj++)
+			dup |= (cand[jj][0] == cand[ii][0] && cand[jj][1] == cand[ii][1]);
+		if (dup || (cost = me_cost(me, &s, cand[ii][0], cand[ii][1], &sad)) < 0)
+			continue;
+		if (ii == 0 && !((skipx | skipy) & 3))
+			skip_sad = sad;
+		if (bcost < 0 || cost < bcost) {
+			bcost = cost;
+			bsad = sad;
+			bx = cand[ii][0];
+			by = cand[ii][1];
+		}
+	}
+	if (bcost < 0) { // zero is always inside, only reached with an empty window
+		bx = by = 0;
+		bcost = me_cost(me, &s, 0, 0, &bsad);
+	}
+
+	// The predictors missed, try the coarse to fine seed
+	if (me->pyramid && bsad > me->early_sad) {
+		int px, py;
+		me_pyramid(me, &s, &px, &py);
+		cost = me_cost(me, &s, px, py, &sad);
+		if (cost >= 0 && cost < bcost) {
+			bcost = cost;
+			bsad = sad;
+			bx = px;
+			by = py;
+			me->num_pyramid++;
+		}
+	}
+
+	if (bsad <= me->early_sad) {
+		me->num_early++;
+	}
+	else {
+		// Hexagon steps while the centre moves, then the 8 neighbours of the last centre
+		for (int iter = 0; iter < me->range; iter++) {
+			int cx = bx, cy = by;
+			for (int ii = 0; ii < 6; ii++) {
+				cost = me_cost(me, &s, cx + hex[ii][0], cy + hex[ii][1], &sad);
+				if (cost >= 0 && cost < bcost) {
+					bcost = cost;
+					bsad = sad;
+					bx = cx + hex[ii][0];
+					by = cy + hex[ii][1];
+				}
+			}
+			if (bx == cx && by == cy)
+				break;
+		}
+		{
+			int cx = bx, cy = by;
+			for (int ii = 0; ii < 8; ii++) {
+				cost = me_cost(me, &s, cx + sqr[ii][0], cy + sqr[ii][1], &sad);
+				if (cost >= 0 && cost < bcost) {
+					bcost = cost;
+					bsad = sad;
+					bx = cx + sqr[ii][0];
+					by = cy + sqr[ii][1];
+				}
+			}
+		}
+	}
+
+	if (me->subpel) {
+		// Half then quarter sample steps around the best, the 8 neighbours each; the skip mv is compared last
+		int qx = bx * 4, qy = by * 4, satd;
+		bcost = me_qcost(me, &s, qx, qy, &bsad);
+		for (int step = 2; step >= 1; step >>= 1) {
+			int cx = qx, cy = qy;
+			for (int ii = 0; ii < 8; ii++) {
+				cost = me_qcost(me, &s, cx + sqr[ii][0] * step, cy + sqr[ii][1] * step, &satd);
+				if (cost >= 0 && cost < bcost) {
+					bcost = cost;
+					bsad = satd;
+					qx = cx + sqr[ii][0] * step;
+					qy = cy + sqr[ii][1] * step;
+				}
+			}
+		}
+		if (me_qcost(me, &s, skipx, skipy, &satd) >= 0 && satd <= bcost) {
+			qx = skipx;
+			qy = skipy;
+			bsad = satd;
+		}
+		*mvx = qx;
+		*mvy = qy;
+		if (qx || qy)
+			me->num_moved++;
+		return(bsad);
+	}
+
+	// The skip mv needs no mvd bits if the residual quantizes away
+	if (skip_sad >= 0 && skip_sad <= bcost) {
+		bx = skipx >> 2;
+		by = skipy >> 2;
+		bsad = skip_sad;
+	}
+	*mvx = bx * 4;
+	*mvy = by * 4;
+	if (bx || by)
+		me->num_moved++;
+	return(bsad);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Motion compensation
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+// 8.4.2.2.1 from the half sample planes, integer mvs read the picture only
+void gg_me_pred_luma(const RefPic* ref, int stride_y, int mbx, int mby, int mvx, int mvy, unsigned char* pred)
+{
+	int pitch;
+	const unsigned char* p = me_qpel_block(ref, stride_y, mbx * 64 + mvx, mby * 64 + mvy, pred, &pitch);
+	if (p != pred)
+		for (int yy = 0; yy < 16; yy++, p += pitch)
+			memcpy(&pred[yy * 16], p, 16);
+}
+
+// 8.4.2.2.2, the chroma mv is the luma mv in eighth chroma samples
+void gg_me_pred_chroma(const unsigned char* ref_c, int stride_c, int mbx, int mby, int mvx, int mvy, unsigned char* pred)
+{
+	const unsigned char* p = ref_c + (mby * 8 + (mvy >> 3)) * stride_c + mbx * 8 + (mvx >> 3);
+	int fx = mvx & 7;
+	int fy = mvy & 7;
+	int w00 = (8 - fx) * (8 - fy), w01 = fx * (8 - fy), w10 = (8 - fx) * fy, w11 = fx * fy;
+
+	if (!fx && !fy) {
+		for (int yy = 0; yy < 8; yy++, p += stride_c)
+			memcpy(&pred[yy * 8], p, 8);
+		return;
+	}
+	for (int yy = 0; yy < 8; yy++, p += stride_c)
+		for (int xx = 0; xx < 8; xx++)
+			pred[yy * 8 + xx] = (unsigned char)((w00 * p[xx] + w01 * p[xx + 1] + w10 * p[xx + stride_c] + w11 * p[xx + stride_c + 1] + 32) >> 6);
+}
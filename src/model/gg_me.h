@@ -0,0 +1,70 @@
+#pragma once
+
+#include "gg_refpic.h"
+
+// Motion estimation for P_L0_16x16 macroblocks
+// Integer pel search around the H.264 mv predictors (8.4.1.3): the best of the predictor candidates,
+// then hexagon steps until none improves and a final diamond refinement, SAD plus lambda * mvd bits.
+// With pyramid on, a coarse to fine search seeds the candidates: every position of the window on the 4x downsampled
+// luma, then +-2 samples on the 2x level. A +-64 window then costs about what a +-8 full search would.
+// With subpel on, half then quarter sample steps around the integer best refine it, SATD plus lambda * mvd bits.
+// Motion vectors are in quarter luma samples. Predicted blocks stay inside the decoded
+// (macroblock aligned) reference picture; the half sample planes are built once per reference
+// picture, a macroblock row band at a time as its rows are final, and quarter samples average two planes.
+
+#define GG_ME_MAX_RANGE 64 // luma samples
+
+// Motion of one coded macroblock, kept for the whole picture (mv prediction, skip mv)
+typedef struct _MbMotion {
+	short mvx;
+	short mvy;
+	signed char refidx; // -1 intra (PCM)
+} MbMotion;
+
+typedef struct _MeCtx {
+	int mb_width;
+	int mb_height;
+	int range; // search window, +-luma samples around the co-located macroblock
+	int subpel; // half and quarter sample refinement, needs the reference half sample planes
+	int pyramid; // coarse to fine seed, needs the reference downsampled planes
+	int early_sad; // stop searching once a candidate has a SAD this low
+	int first_mb; // first mb address of the current slice, earlier macroblocks are not available
+	MbMotion* mbm; // mb_width * mb_height, current picture
+	short* hpel_tmp; // 6 tap intermediates of one row band, 21 rows of the picture width
+	unsigned char* low[2]; // 2x and 4x downsampled source picture, row pitch mb_width * 8 and * 4
+
+	// Stats
+	long long num_mb; // searched
+	long long num_sad; // 16x16 SADs evaluated
+	long long num_satd; // 16x16 sub sample SATDs evaluated
+	long long num_low; // downsampled SADs evaluated (4x4 and 8x8)
+	long long num_pyramid; // searches seeded from the pyramid
+	long long num_early; // searches stopped at a predictor
+	long long num_moved; // chose a non zero mv
+} MeCtx;
+
+int gg_me_open(MeCtx* me, int mb_width, int mb_height, int range, int subpel, int pyramid);
+void gg_me_close(MeCtx* me);
+void gg_me_init_slice(MeCtx* me, int first_mb);
+
+// Predictors, from the macroblocks already coded in the slice
+void gg_me_pred_mv(const MeCtx* me, int mbx, int mby, int refidx, int* mvx, int* mvy);
+void gg_me_skip_mv(const MeCtx* me, int mbx, int mby, int* mvx, int* mvy); // P_Skip motion (8.4.1.1)
+int gg_me_mv_ok(const MeCtx* me, int mbx, int mby, int mvx, int mvy); // predicted block (and its quarter sample neighbours) inside the picture
+
+// Build the half sample planes of a reference picture up to mb_rows macroblock rows (6 tap, 8.4.2.2.1)
+// Needs the luma of rows 0..mb_rows final (3 sample lines below the last band). Writes the edge samples into the luma border.
+void gg_me_hpel_rows(MeCtx* me, RefPic* pic, int stride_y, int mb_rows);
+
+// Downsampled luma, 2x2 averages per level: reference rows up to mb_rows macroblock rows (needs those rows final),
+// and the source picture one macroblock at a time from its 16x16 samples (stride 16)
+void gg_me_lowres_rows(MeCtx* me, RefPic* pic, int stride_y, int mb_rows);
+void gg_me_lowres_mb(MeCtx* me, int mbx, int mby, const unsigned char* orig);
+
+// Search the reference for a 16x16 source block (stride 16), returns the SAD (SATD with subpel) of the chosen mv
+int gg_me_search(MeCtx* me, int mbx, int mby, const unsigned char* orig, const RefPic* ref, int stride_y, int qp, int mvpx, int mvpy, int skipx, int skipy, int* mvx, int* mvy);
+void gg_me_set_mb(MeCtx* me, int mbx, int mby, int refidx, int mvx, int mvy);
+
+// Motion compensated prediction of a macroblock, luma 16x16 (quarter sample) and chroma 8x8 (eighth sample bilinear)
+void gg_me_pred_luma(const RefPic* ref, int stride_y, int mbx, int mby, int mvx, int mvy, unsigned char* pred);
+void gg_me_pred_chroma(const unsigned char* ref_c, int stride_c, int mbx, int mby, int mvx, int mvy, unsigned char* pred);
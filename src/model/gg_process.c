@@ -76,13 +76,13 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 	/////////////////////////////////////////
 
 	// Select qpy or derive qpc
-	qp = (ch_flag) ? qpc_table[qpy] : qpy;
+	qp = (ch_flag) ? gg_quant.qpc[qpy] : qpy;
 
 	// Forward quant 16 coeffs
 	for (int ii = 0; ii < 16; ii++) {
 		abscoeff = (e[ii] < 0) ? -e[ii] : e[ii]; // remove the sign, so we round down towards zero using >>
 		negcoeff = (e[ii] < 0) ? 1 : 0; // we will restore the sign after quantization
-		quant = (dc_flag) ? Qmat[qp % 6][0][0] : Qmat[qp % 6][ii >> 2][ii & 3];
+		quant = (dc_flag) ? gg_quant.qmat[qp % 6][0][0] : gg_quant.qmat[qp % 6][ii >> 2][ii & 3];
 		qshift = (qp / 6) + ((dc_flag & !ch_flag) ? 9 : (dc_flag && ch_flag) ? 8 : 7);
 		qc = ((abscoeff * quant) >> qshift ) + offset; // 8 fractional bits still remain, larger dc shift
 		qcdz = (qc < deadzone) ? 0 : (qc >> 8);
@@ -120,12 +120,12 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 	else { // Inverse quant 4x4, with special scaling for DC coeff when appropriate
 		for (int ii = 0; ii < 16; ii++) { 
 			if (ii == 0 && ac_flag && ch_flag) { // Handle Chroma dc coeff
-				dequant = 16 * Dmat[qp % 6][0][0];
+				dequant = 16 * gg_quant.dmat[qp % 6][0][0];
 				coeff_dc = dc_hold[((bidx&1)<<0)+((bidx&2)<<1)]; // sample 0,1,4,5
 				f[0] = ((coeff_dc * dequant) << (qp / 6)) >> 5;
 			}
 			else if (ii == 0 && ac_flag) { // Intra 16 dc coeff
-				dequant = 16 * Dmat[qp % 6][0][0];
+				dequant = 16 * gg_quant.dmat[qp % 6][0][0];
 				coeff_dc = dc_hold[((bidx & 1) << 0) + ((bidx & 2) << 1) + ((bidx & 4) >> 1) + ((bidx & 8) << 0)];
 				if (qp >= 36) {
 					f[0] = (coeff_dc * dequant) << (qp / 6 - 6);
@@ -135,7 +135,7 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 				}
 			}
 			else { // normal 4x4 quant
-				dequant = 16 * Dmat[qp % 6][ii >> 2][ii & 3];
+				dequant = 16 * gg_quant.dmat[qp % 6][ii >> 2][ii & 3];
 				if (qp >= 24) {
 					f[ii] = (coeff[ii] * dequant) << (qp / 6 - 4);
 				}
@@ -296,7 +296,7 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 		abvnc[abv_idx] = num_coeff;
 	}
 
-	vlc_coeff_token = ( num_coeff == 0 ) ? x264_coeff0_token[coeff_table_idx] : x264_coeff_token[coeff_table_idx][num_coeff-1][trailing_ones];
+	vlc_coeff_token = gg_vlc(( num_coeff == 0 ) ? gg_cavlc.coeff0_token[coeff_table_idx] : gg_cavlc.coeff_token[coeff_table_idx][num_coeff-1][trailing_ones]);
 
 	//////////////////////////////////////////
 	// Syntax Element: Total zeros
@@ -314,13 +314,13 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 		int last_sig;
 		for (last_sig = max_coeff; scan[last_sig-1] == 0; last_sig--);
 		total_zeros = last_sig - num_coeff;
-		vlc_total_zeros = x264_total_zeros_2x2_dc[num_coeff - 1][total_zeros];
+		vlc_total_zeros = gg_vlc(gg_cavlc.total_zeros_2x2_dc[num_coeff - 1][total_zeros]);
 	}
 	else { // use table 9-7, 9-8
 		int last_sig;
 		for (last_sig = max_coeff; scan[last_sig - 1] == 0; last_sig--);
 		total_zeros = last_sig - num_coeff;
-		vlc_total_zeros = x264_total_zeros[num_coeff - 1][total_zeros];
+		vlc_total_zeros = gg_vlc(gg_cavlc.total_zeros[num_coeff - 1][total_zeros]);
 	}
 
 	//////////////////////////////////////////
@@ -341,7 +341,7 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 		for (last_sig = max_coeff - 1; scan[last_sig] == 0; last_sig--); // find last sign coeff
 		for (int coeff_idx = last_sig-1, sig_count = 0; (sig_count < num_coeff-1) && zeros; coeff_idx--) {
 			if (scan[coeff_idx]) {
-				vlc_run_before[sig_count] = x264_run_before_init[MIN(zeros-1, 6)][run];
+				vlc_run_before[sig_count] = gg_vlc(gg_cavlc.run_before[MIN(zeros-1, 6)][run]);
 				sig_count++;
 				zeros -= run;
 				run = 0;
@@ -590,102 +590,3 @@ int gg_process_block(int qpy, int offset, int deadzone, int *ref, int *orig, int
 
 	return(num_coeff);
 }
-
-void test_run_before()
-{
-	vlc_t vlc_run_before[15]; // 0th is total_zero's and then 14 run befores
-	int test;
-	int total_zeros;
-	int num_coeff;
-	int zeros;
-	int run;
-	int last_sig;
-	int scan[16];
-	int bitcount;
-	int max_bits;
-	int max_bits_n[15][15];
-
-	max_bits = 0;
-	for (int ii = 0; ii < 15; ii++)
-		for (int jj = 0; jj < 15; jj++)
-			max_bits_n[ii][jj] = 0;
-
-	for (test = 1; test < 65534; test++) {
-		// Setup scan
-		for (int ii = 0; ii < 16; ii++) 
-			scan[ii] = (test & (1 << ii)) ? 1 : 0;
-		// clear VLCs //
-		for (int ii = 0; ii < 15; ii++) {
-			vlc_run_before[ii].i_size = 0;
-			vlc_run_before[ii].i_bits = 0;
-		}
-		// Calc num_coeff
-		num_coeff = 0;
-		for (int ii = 0; ii < 16; ii++)
-			num_coeff += (scan[ii]) ? 1 : 0;
-		// Calc total_zero's, last_sig
-		for (last_sig = 16; scan[last_sig - 1] == 0; last_sig--);
-		total_zeros = last_sig - num_coeff;
-		// COde Total Zeros's
-		if (num_coeff == 16 || num_coeff == 0) {
-			vlc_run_before[0].i_bits = 0;
-			vlc_run_before[0].i_size = 0;
-		}
-		else { // use table 9-7, 9-8
-			vlc_run_before[0] = x264_total_zeros[num_coeff - 1][total_zeros];
-		}
-		// Determine run before
-		zeros = total_zeros;
-		run = 0;
-		if (num_coeff > 1 && total_zeros) {
-			for (int coeff_idx = last_sig - 2, sig_count = 0; (sig_count < num_coeff - 1) && zeros; coeff_idx--) {
-				if (scan[coeff_idx]) {
-					vlc_run_before[sig_count+1] = x264_run_before_init[MIN(zeros - 1, 6)][run];
-					sig_count++;
-					zeros -= run;
-					run = 0;
-				}
-				else {
-					run++;
-				}
-			}
-		}
-		// Count bits
-		bitcount = 0;
-		for (int ii = 0; ii < 15; bitcount += vlc_run_before[ii++].i_size);
-		if (bitcount > max_bits) {
-			// Print VLC
-			printf("%04x = %3d nc %2d tz %2d  : ", test, bitcount, num_coeff, total_zeros );
-			for (int ii = 0; ii < 15; ii++)
-				if (vlc_run_before[ii].i_size) {
-					for (int bb = vlc_run_before[ii].i_size - 1; bb >= 0; bb--)
-						printf("%d", (vlc_run_before[ii].i_bits >> bb) & 1);
-					printf(" ");
-				}
-			printf("\n");
-		}
-		max_bits = MAX(bitcount, max_bits);
-
-		// Accumulated max_bits_n 
-
-		for ( int acc_len = 0; acc_len < 15; acc_len++) {
-			for (int acc_off = 0; acc_off < (15 - acc_len); acc_off++) {
-				int sum = 0;
-				for (int idx = 0; idx < acc_len+1; idx++) {
-					sum += vlc_run_before[idx + acc_off].i_size;
-				}
-				max_bits_n[acc_len][acc_off] = MAX(sum, max_bits_n[acc_len][acc_off]);
-			}
-		}
-	} // test
-	printf("Max length run before = %d\n", max_bits);
-
-	// Print summary
-	for (int ii = 0; ii < 15; ii++) {
-		printf("sum window = %2d : ", ii + 1);
-		for (int jj = 0; jj < (15 - ii); jj++)
-			printf("%2d ", max_bits_n[ii][jj]);
-		printf("\n");
-	}
-
-}
\ No newline at end of file
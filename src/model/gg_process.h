@@ -21,7 +21,6 @@ typedef struct _bitbuffer {
 
 int gg_process_block(int qpy, int offset, int deadzone, int* ref, int* orig, int* dc_hold, int cidx, int bidx, char *lefnc, char *abvnc, int* recon, bitbuffer *bits, int* bitcount, int* sad, int* ssd);
 int gg_iprocess_block(int qpy, int* ref, int* dc_hold, int cidx, int bidx, char* lefnc, char* abvnc, int* recon, bitbuffer* bits, int skip);
-void test_run_before();
 
 
 
@@ -4,28 +4,32 @@
 //  Quant tables
 /////////////////////////////
 
-const int Qmat[6][4][4] = { { { 13107, 8066, 13107, 8066 }, { 8066, 5243, 8066, 5243 }, { 13107, 8066, 13107, 8066 }, { 8066, 5243, 8066, 5243} },
-                            { { 11916, 7490, 11916, 7490 }, { 7490, 4660, 7490, 4660 }, { 11916, 7490, 11916, 7490 }, { 7490, 4660, 7490, 4660} },
-                            { { 10082, 6554, 10082, 6554 }, { 6554, 4194, 6554, 4194 }, { 10082, 6554, 10082, 6554 }, { 6554, 4194, 6554, 4194} },
-                            { { 9362 , 5825, 9362 , 5825 }, { 5825, 3647, 5825, 3647 }, { 9362 , 5825, 9362 , 5825 }, { 5825, 3647, 5825, 3647} },
-                            { { 8192 , 5243, 8192 , 5243 }, { 5243, 3355, 5243, 3355 }, { 8192 , 5243, 8192 , 5243 }, { 5243, 3355, 5243, 3355} },
-                            { { 7282 , 4559, 7282 , 4559 }, { 4559, 2893, 4559, 2893 }, { 7282 , 4559, 7282 , 4559 }, { 4559, 2893, 4559, 2893} } };
+GG_TABLE_ALIGN const QuantTables gg_quant = {
+    .qmat = { { { 13107, 8066, 13107, 8066 }, { 8066, 5243, 8066, 5243 }, { 13107, 8066, 13107, 8066 }, { 8066, 5243, 8066, 5243} },
+              { { 11916, 7490, 11916, 7490 }, { 7490, 4660, 7490, 4660 }, { 11916, 7490, 11916, 7490 }, { 7490, 4660, 7490, 4660} },
+              { { 10082, 6554, 10082, 6554 }, { 6554, 4194, 6554, 4194 }, { 10082, 6554, 10082, 6554 }, { 6554, 4194, 6554, 4194} },
+              { { 9362 , 5825, 9362 , 5825 }, { 5825, 3647, 5825, 3647 }, { 9362 , 5825, 9362 , 5825 }, { 5825, 3647, 5825, 3647} },
+              { { 8192 , 5243, 8192 , 5243 }, { 5243, 3355, 5243, 3355 }, { 8192 , 5243, 8192 , 5243 }, { 5243, 3355, 5243, 3355} },
+              { { 7282 , 4559, 7282 , 4559 }, { 4559, 2893, 4559, 2893 }, { 7282 , 4559, 7282 , 4559 }, { 4559, 2893, 4559, 2893} } },
 
-const int Dmat[6][4][4] = { { { 10, 13, 10, 13 }, { 13, 16, 13, 16 }, { 10, 13, 10, 13 }, { 13, 16, 13, 16} },
-                            { { 11, 14, 11, 14 }, { 14, 18, 14, 18 }, { 11, 14, 11, 14 }, { 14, 18, 14, 18} },
-                            { { 13, 16, 13, 16 }, { 16, 20, 16, 20 }, { 13, 16, 13, 16 }, { 16, 20, 16, 20} },
-                            { { 14, 18, 14, 18 }, { 18, 23, 18, 23 }, { 14, 18, 14, 18 }, { 18, 23, 18, 23} },
-                            { { 16, 20, 16, 20 }, { 20, 25, 20, 25 }, { 16, 20, 16, 20 }, { 20, 25, 20, 25} },
-                            { { 18, 23, 18, 23 }, { 23, 29, 23, 29 }, { 18, 23, 18, 23 }, { 23, 29, 23, 29} } };
+    .dmat = { { { 10, 13, 10, 13 }, { 13, 16, 13, 16 }, { 10, 13, 10, 13 }, { 13, 16, 13, 16} },
+              { { 11, 14, 11, 14 }, { 14, 18, 14, 18 }, { 11, 14, 11, 14 }, { 14, 18, 14, 18} },
+              { { 13, 16, 13, 16 }, { 16, 20, 16, 20 }, { 13, 16, 13, 16 }, { 16, 20, 16, 20} },
+              { { 14, 18, 14, 18 }, { 18, 23, 18, 23 }, { 14, 18, 14, 18 }, { 18, 23, 18, 23} },
+              { { 16, 20, 16, 20 }, { 20, 25, 20, 25 }, { 16, 20, 16, 20 }, { 20, 25, 20, 25} },
+              { { 18, 23, 18, 23 }, { 23, 29, 23, 29 }, { 18, 23, 18, 23 }, { 23, 29, 23, 29} } },
 
-const int qpc_table[52] = { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,
-                            29, 30, 31, 32, 32, 33, 34, 34,35,35,36,36,37,37,37,38,38,38,39,39,39,39 };
+    .qpc = { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,
+           29, 30, 31, 32, 32, 33, 34, 34,35,35,36,36,37,37,37,38,38,38,39,39,39,39 }
+};
 
-const int alpha_table[52] = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,4,5,6,7,8,9,10,12,13,15,17,20,22,25,28,32,36,40,45,50,56,63,71,80,90,101,113,127,144,162,182,203,226,255,255 };
-const int  beta_table[52] = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,2,2,2,3,3,3,3,4,4,4,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13,14,14,15,15,16,16,17,17,18,18 };
-const int tc0_table[3][52] = { {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,2,2,2,2,3,3,3,4,4,4,5,6,6,7,8,9,10,11,13},
-                               {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,2,2,2,2,3,3,3,4,4,5,5,6,7,8,8,10,11,12,13,15,17},
-                               {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,2,2,2,2,3,3,3,4,4,4,5,6,6,7,8,9,10,11,13,14,16,18,20,23,25} };
+GG_TABLE_ALIGN const DeblockTables gg_dbk = {
+    .alpha = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,4,5,6,7,8,9,10,12,13,15,17,20,22,25,28,32,36,40,45,50,56,63,71,80,90,101,113,127,144,162,182,203,226,255,255 },
+    .beta = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,2,2,2,3,3,3,3,4,4,4,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13,14,14,15,15,16,16,17,17,18,18 },
+    .tc0 = { {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,2,2,2,2,3,3,3,4,4,4,5,6,6,7,8,9,10,11,13},
+             {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,2,2,2,2,3,3,3,4,4,5,5,6,7,8,8,10,11,12,13,15,17},
+             {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,2,2,2,2,3,3,3,4,4,4,5,6,6,7,8,9,10,11,13,14,16,18,20,23,25} }
+};
 
 
 
@@ -33,7 +37,8 @@ const int tc0_table[3][52] = { {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,
 //  VLD Parsing tables
 /////////////////////////////
 
-const int coeff_token_parse_table[5][62][4] = {
+GG_TABLE_ALIGN const CavldTables gg_cavld = {
+.coeff_token = {
     { // nc < 2
         { 0x01,1,0,0}, // 1
         { 0x05,6,0,1}, // 000101
@@ -306,9 +311,9 @@ const int coeff_token_parse_table[5][62][4] = {
         { 0x02,8,2,4}, // 00000010
         { 0x00,7,3,4}  // 0000000
     }
-};
+},
 
-const int total_zeros_parse_table[18][16][3] = {
+.total_zeros = {
     // 2x2
     {
         { 0x01,1,0 }, // 1
@@ -492,10 +497,10 @@ const int total_zeros_parse_table[18][16][3] = {
         { 0x00, 1, 0 }, // 0
         { 0x01,1,1 } // 1
     }
-};
+},
 
 
-const int run_before_parse_table[7][15][3] = {
+.run_before = {
     {
         { 0x01,1,0 }, // 1
         { 0x00,1,1 } // 0
@@ -552,6 +557,7 @@ const int run_before_parse_table[7][15][3] = {
         { 0x01,10,13 }, // 0000000001
         { 0x01,11,14 } // 00000000001
     }
+}
 };
 
 
@@ -559,8 +565,9 @@ const int run_before_parse_table[7][15][3] = {
 //  VLC Coding tables
 /////////////////////////////
 
- /* [nC] */
-const vlc_t x264_coeff0_token[6] =
+GG_TABLE_ALIGN const CavlcTables gg_cavlc = {
+/* [nC] */
+.coeff0_token =
 {
     { 0x1, 1 }, /* str=1 */
     { 0x3, 2 }, /* str=11 */
@@ -568,10 +575,10 @@ const vlc_t x264_coeff0_token[6] =
     { 0x3, 6 }, /* str=000011 */
     { 0x1, 2 }, /* str=01 */
     { 0x1, 1 }, /* str=1 */
-};
+},
 
 /* [nC][i_total_coeff-1][i_trailing] */
-const vlc_t x264_coeff_token[6][16][4] =
+.coeff_token =
 {
     { /* table 0 */
         { /* i_total 1 */
@@ -1023,10 +1030,10 @@ const vlc_t x264_coeff_token[6][16][4] =
             { 0x4, 11 }, /* str=00000000100 */
         },
     },
-};
+},
 
 /* [i_total_coeff-1][i_total_zeros] */
-const vlc_t x264_total_zeros[15][16] =
+.total_zeros =
 {
     { /* i_total 1 */
         { 0x1, 1 }, /* str=1 */
@@ -1193,10 +1200,10 @@ const vlc_t x264_total_zeros[15][16] =
         { 0x0, 1 }, /* str=0 */
         { 0x1, 1 }, /* str=1 */
     },
-};
+},
 
 /* [i_total_coeff-1][i_total_zeros] */
-const vlc_t x264_total_zeros_2x2_dc[3][4] =
+.total_zeros_2x2_dc =
 {
     { /* i_total 1 */
         { 0x1, 1 }, /* str=1 */
@@ -1213,10 +1220,10 @@ const vlc_t x264_total_zeros_2x2_dc[3][4] =
         { 0x1, 1 }, /* str=1 */
         { 0x0, 1 }, /* str=0 */
     },
-};
+},
 
 /* [i_total_coeff-1][i_total_zeros] */
-const vlc_t x264_total_zeros_2x4_dc[7][8] =
+.total_zeros_2x4_dc =
 {
     { /* i_total 1 */
         { 0x1, 1 }, /* str=1 */
@@ -1267,10 +1274,10 @@ const vlc_t x264_total_zeros_2x4_dc[7][8] =
         { 0x0, 1 }, /* str=0 */
         { 0x1, 1 }, /* str=1 */
     }
-};
+},
 
 /* [MIN( i_zero_left-1, 6 )][run_before] */
-const vlc_t x264_run_before_init[7][16] =
+.run_before =
 {
     { /* i_zero_left 1 */
         { 0x1, 1 }, /* str=1 */
@@ -1328,4 +1335,5 @@ const vlc_t x264_run_before_init[7][16] =
         { 0x1, 10 }, /* str=0000000001 */
         { 0x1, 11 }, /* str=00000000001 */
     },
+}
 };
\ No newline at end of file
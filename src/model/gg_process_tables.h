@@ -1,24 +1,58 @@
 #pragma once
 
+// Constant tables, laid out at compile time in the narrowest types and grouped by the stage
+// that reads them into cache line aligned blocks: quant 340 bytes, deblock 260, CAVLC coding 1620, CAVLC parsing 2419
+
+#ifdef _MSC_VER
+#define GG_TABLE_ALIGN __declspec(align(64))
+#else
+#define GG_TABLE_ALIGN __attribute__((aligned(64)))
+#endif
+
 typedef struct
 {
     unsigned int  i_bits;
     unsigned char i_size;
 } vlc_t;
 
-extern const int Qmat[6][4][4];
-extern const int Dmat[6][4][4];
-extern const int qpc_table[52];
-extern const vlc_t x264_coeff0_token[6];
-extern const vlc_t x264_coeff_token[6][16][4];
-extern const vlc_t x264_total_zeros[15][16];
-extern const vlc_t x264_total_zeros_2x2_dc[3][4];
-extern const vlc_t x264_total_zeros_2x4_dc[7][8];
-extern const vlc_t x264_run_before_init[7][16];
-extern const int coeff_token_parse_table[5][62][4];
-extern const int total_zeros_parse_table[18][16][3];
-extern const int run_before_parse_table[7][15][3];
-
-extern const int alpha_table[52];
-extern const int beta_table[52];
-extern const int tc0_table[3][52];
\ No newline at end of file
+// Table codeword, the values of all table codes fit a byte
+typedef struct
+{
+    unsigned char i_bits;
+    unsigned char i_size;
+} vlc8_t;
+
+static inline vlc_t gg_vlc(vlc8_t v) { vlc_t r; r.i_bits = v.i_bits; r.i_size = v.i_size; return(r); }
+
+typedef struct _QuantTables {
+    unsigned short qmat[6][4][4];
+    unsigned char dmat[6][4][4];
+    unsigned char qpc[52]; // chroma qp
+} QuantTables;
+
+typedef struct _DeblockTables {
+    unsigned char alpha[52];
+    unsigned char beta[52];
+    unsigned char tc0[3][52];
+} DeblockTables;
+
+typedef struct _CavlcTables {
+    vlc8_t coeff0_token[6];
+    vlc8_t coeff_token[6][16][4];
+    vlc8_t total_zeros[15][16];
+    vlc8_t total_zeros_2x2_dc[3][4];
+    vlc8_t total_zeros_2x4_dc[7][8];
+    vlc8_t run_before[7][16];
+} CavlcTables;
+
+// Parse entries: bitword, length, then the decoded values
+typedef struct _CavldTables {
+    unsigned char coeff_token[5][62][4]; // trailing ones, total coeff
+    unsigned char total_zeros[18][16][3];
+    unsigned char run_before[7][15][3];
+} CavldTables;
+
+extern const QuantTables gg_quant;
+extern const DeblockTables gg_dbk;
+extern const CavlcTables gg_cavlc;
+extern const CavldTables gg_cavld;
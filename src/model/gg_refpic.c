@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include "gg_refpic.h"
+
+int gg_refpic_init(RefPicMgr* mgr, int width, int height, MemPool* pool, int planes)
+{
+	size_t size_y, size_c, size_h, size_l1, size_l2, size;
+	int mb_w = (int)GG_ALIGN(width, 16);
+	int mb_h = (int)GG_ALIGN(height, 16);
+
+	memset(mgr, 0, sizeof(RefPicMgr));
+	mgr->width = width;
+	mgr->height = height;
+	mgr->stride_y = (int)GG_ALIGN(mb_w + 2 * GG_REFPIC_PAD, GG_ALLOC_ALIGN);
+	mgr->stride_c = mgr->stride_y >> 1;
+	mgr->pool = pool;
+	mgr->planes = planes;
+	size_y = (size_t)mgr->stride_y * (mb_h + 2 * GG_REFPIC_PAD);
+	size_c = (size_t)mgr->stride_c * ((mb_h >> 1) + GG_REFPIC_PAD);
+	size_h = (planes & GG_REFPIC_HPEL) ? 3 * size_y : 0;
+	size_l1 = (planes & GG_REFPIC_LOWRES) ? (size_t)(mgr->stride_y >> 1) * (mb_h >> 1) : 0;
+	size_l2 = (planes & GG_REFPIC_LOWRES) ? (size_t)(mgr->stride_y >> 2) * (mb_h >> 2) : 0;
+	size = size_y + 2 * size_c + size_h + size_l1 + size_l2;
+	gg_mutex_init(&mgr->lock);
+	gg_cond_init(&mgr->cond);
+	for (int ii = 0; ii < GG_REFPIC_POOL; ii++) {
+		char* buf = (char*)((pool) ? gg_pool_alloc(pool, size) : gg_alloc(size, 0));
+		if (!buf) {
+			printf("ERROR: out of memory for reference pictures\n");
+			gg_refpic_close(mgr);
+			return(-1);
+		}
+		mgr->pic[ii].buf = buf;
+		mgr->pic[ii].y = buf + (size_t)mgr->stride_y * GG_REFPIC_PAD + GG_REFPIC_PAD;
+		mgr->pic[ii].cb = buf + size_y + (size_t)mgr->stride_c * (GG_REFPIC_PAD / 2) + GG_REFPIC_PAD / 2;
+		mgr->pic[ii].cr = buf + size_y + size_c + (size_t)mgr->stride_c * (GG_REFPIC_PAD / 2) + GG_REFPIC_PAD / 2;
+		for (int jj = 0; jj < 3; jj++)
+			mgr->pic[ii].hpel[jj] = (size_h) ? mgr->pic[ii].y + size_y + 2 * size_c + jj * size_y : NULL;
+		mgr->pic[ii].low[0] = (size_l1) ? buf + size_y + 2 * size_c + size_h : NULL;
+		mgr->pic[ii].low[1] = (size_l2) ? buf + size_y + 2 * size_c + size_h + size_l1 : NULL;
+		mgr->pic[ii].refcnt = 0;
+	}
+	return((gg_refpic_new_recon(mgr)) ? 0 : -1);
+}
+
+void gg_refpic_addref(RefPicMgr* mgr, RefPic* pic)
+{
+	if (pic) {
+		gg_mutex_lock(&mgr->lock);
+		pic->refcnt++;
+		gg_mutex_unlock(&mgr->lock);
+	}
+}
+
+void gg_refpic_release(RefPicMgr* mgr, RefPic* pic)
+{
+	if (pic) {
+		gg_mutex_lock(&mgr->lock);
+		if (pic->refcnt > 0 && --pic->refcnt == 0)
+			gg_cond_broadcast(&mgr->cond);
+		gg_mutex_unlock(&mgr->lock);
+	}
+}
+
+// Take a free buffer for the next recon picture, the previous recon (if any) is dropped
+// Waits if all buffers are referenced or still queued for output
+RefPic* gg_refpic_new_recon(RefPicMgr* mgr)
+{
+	RefPic* pic = NULL;
+
+	gg_refpic_release(mgr, mgr->recon);
+	mgr->recon = NULL;
+	gg_mutex_lock(&mgr->lock);
+	for (;;) {
+		int held = 0; // buffers held by outputs, they will come back
+		for (int ii = 0; ii < GG_REFPIC_POOL && !pic; ii++) {
+			if (mgr->pic[ii].refcnt == 0)
+				pic = &mgr->pic[ii];
+			else if (&mgr->pic[ii] != mgr->ref[0] && &mgr->pic[ii] != mgr->ref[1])
+				held++;
+		}
+		if (pic || !held)
+			break;
+		mgr->num_waits++;
+		gg_cond_wait(&mgr->cond, &mgr->lock);
+	}
+	if (pic) {
+		pic->refcnt = 1;
+		pic->hpel_rows = 0;
+		pic->low_rows = 0;
+	}
+	gg_mutex_unlock(&mgr->lock);
+	if (!pic)
+		printf("ERROR: no free picture buffer for recon\n");
+	mgr->recon = pic;
+	return(pic);
+}
+
+// Point a ref slot at a picture, the old one is released
+void gg_refpic_set_ref(RefPicMgr* mgr, int refidx, RefPic* pic)
+{
+	gg_refpic_addref(mgr, pic);
+	gg_refpic_release(mgr, mgr->ref[refidx]);
+	mgr->ref[refidx] = pic;
+}
+
+// Coded recon becomes reference refidx, a fresh buffer becomes the recon
+void gg_refpic_recon_to_ref(RefPicMgr* mgr, int refidx)
+{
+	gg_refpic_set_ref(mgr, refidx, mgr->recon);
+	gg_refpic_new_recon(mgr);
+}
+
+void gg_refpic_close(RefPicMgr* mgr)
+{
+	for (int ii = 0; ii < GG_REFPIC_POOL; ii++) {
+		if (mgr->pool)
+			gg_pool_free(mgr->pool, mgr->pic[ii].buf);
+		else
+			gg_free(mgr->pic[ii].buf);
+		mgr->pic[ii].buf = NULL;
+		mgr->pic[ii].y = mgr->pic[ii].cb = mgr->pic[ii].cr = NULL;
+		mgr->pic[ii].hpel[0] = mgr->pic[ii].hpel[1] = mgr->pic[ii].hpel[2] = NULL;
+		mgr->pic[ii].low[0] = mgr->pic[ii].low[1] = NULL;
+		mgr->pic[ii].refcnt = 0;
+	}
+	mgr->recon = NULL;
+	for (int ii = 0; ii < GG_REFPIC_NUM_REF; ii++)
+		mgr->ref[ii] = NULL;
+	gg_cond_destroy(&mgr->cond);
+	gg_mutex_destroy(&mgr->lock);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "gg_thread.h"
+#include "gg_alloc.h"
+
+// Reference picture manager
+// Owns a small pool of 4:2:0 frame buffers. The recon picture is turned into a reference by
+// pointer (no copy), pictures are refcounted so one buffer can sit in several ref slots
+// (e.g. the grey long term ref) or be held by an output while a new recon is coded.
+// Refcounts are locked, outputs on other threads (recon writer) release pictures when done.
+
+#define GG_REFPIC_POOL 5 // recon, ref0, ref1, plus two queued for output
+#define GG_REFPIC_NUM_REF 2
+#define GG_REFPIC_PAD 32 // luma border samples around each plane (chroma has half), rows are 64 byte aligned
+
+// Extra planes carried by every picture (gg_refpic_init planes), filled by motion estimation
+#define GG_REFPIC_HPEL   1 // half sample luma planes
+#define GG_REFPIC_LOWRES 2 // 2x and 4x downsampled luma
+
+typedef struct _RefPic {
+	char* y; // top left picture sample, inside the border
+	char* cb;
+	char* cr;
+	void* buf; // allocation
+	int refcnt; // 0 when free
+	char* hpel[3]; // half sample luma planes (x+1/2, y+1/2, both), same layout as y, NULL if not allocated
+	int hpel_rows; // macroblock rows of the half sample planes built since the picture was coded
+	char* low[2]; // 2x and 4x downsampled luma, no border, row pitch stride_y / 2 and / 4, NULL if not allocated
+	int low_rows; // macroblock rows downsampled since the picture was coded
+} RefPic;
+
+typedef struct _RefPicMgr {
+	int width; // luma samples of the output picture, buffers cover whole macroblocks
+	int height;
+	int stride_y; // row pitch, same for every picture
+	int stride_c;
+	MemPool* pool; // frame store memory, NULL for plain aligned allocations
+	int planes; // GG_REFPIC_HPEL | GG_REFPIC_LOWRES carried by each picture
+	RefPic pic[GG_REFPIC_POOL];
+	RefPic* recon; // picture being coded
+	RefPic* ref[GG_REFPIC_NUM_REF]; // refidx 0, 1
+	gg_mutex_t lock;
+	gg_cond_t cond; // a picture was released
+	int num_waits; // times a new recon waited on an output
+} RefPicMgr;
+
+int gg_refpic_init(RefPicMgr* mgr, int width, int height, MemPool* pool, int planes);
+void gg_refpic_addref(RefPicMgr* mgr, RefPic* pic);
+void gg_refpic_release(RefPicMgr* mgr, RefPic* pic);
+RefPic* gg_refpic_new_recon(RefPicMgr* mgr);
+void gg_refpic_recon_to_ref(RefPicMgr* mgr, int refidx);
+void gg_refpic_set_ref(RefPicMgr* mgr, int refidx, RefPic* pic);
+void gg_refpic_close(RefPicMgr* mgr);
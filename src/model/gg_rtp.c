@@ -0,0 +1,209 @@
+#define _CRT_SECURE_NO_WARNINGS 1
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+#include "gg_process.h"
+#include "gg_rtp.h"
+
+#define NAL_TYPE_STAP_A 24
+#define NAL_TYPE_FU_A 28
+
+
+void gg_rtp_init(RtpCtx* rtp, int mtu, int payload_type, int stap_flag, unsigned int ssrc, RtpPacketFn callback, void* callback_arg)
+{
+	rtp->mtu = CLIP3(GG_RTP_MIN_PKT, GG_RTP_MAX_PKT, mtu);
+	if (mtu < GG_RTP_MIN_PKT)
+		printf("Warning: rtp mtu %d raised to %d\n", mtu, GG_RTP_MIN_PKT);
+	rtp->payload_type = payload_type;
+	rtp->stap_flag = stap_flag;
+	rtp->ssrc = ssrc;
+	rtp->seq = 0;
+	rtp->timestamp = 0;
+	rtp->callback = callback;
+	rtp->callback_arg = callback_arg;
+	rtp->sock = -1;
+	rtp->pkt_len = 0;
+	rtp->pkt_nals = 0;
+	rtp->num_pkt = 0;
+	rtp->num_single = 0;
+	rtp->num_stap = 0;
+	rtp->num_fu = 0;
+	rtp->num_bytes = 0;
+}
+
+// Send packets to a UDP port on localhost (in addition to any callback)
+int gg_rtp_open_udp(RtpCtx* rtp, int port)
+{
+	struct sockaddr_in* addr = (struct sockaddr_in*)rtp->addr;
+#ifdef _WIN32
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+	SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock == INVALID_SOCKET) {
+#else
+	int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+#endif
+		printf("ERROR: rtp could not open udp socket\n");
+		return(-1);
+	}
+	memset(rtp->addr, 0, sizeof(rtp->addr));
+	addr->sin_family = AF_INET;
+	addr->sin_port = htons((unsigned short)port);
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	rtp->sock = (long long)sock;
+	return(0);
+}
+
+// Timestamp for the following access unit (90 kHz clock)
+void gg_rtp_set_timestamp(RtpCtx* rtp, unsigned int timestamp)
+{
+	rtp->timestamp = timestamp;
+}
+
+// Fill 12 byte rtp fixed header, and advance sequence number
+static void rtp_header(RtpCtx* rtp, unsigned char* hdr, int marker)
+{
+	hdr[0] = 0x80; // V=2, P=0, X=0, CC=0
+	hdr[1] = ((marker) ? 0x80 : 0) | (rtp->payload_type & 0x7f);
+	hdr[2] = (rtp->seq >> 8) & 0xff;
+	hdr[3] = rtp->seq & 0xff;
+	hdr[4] = (rtp->timestamp >> 24) & 0xff;
+	hdr[5] = (rtp->timestamp >> 16) & 0xff;
+	hdr[6] = (rtp->timestamp >> 8) & 0xff;
+	hdr[7] = rtp->timestamp & 0xff;
+	hdr[8] = (rtp->ssrc >> 24) & 0xff;
+	hdr[9] = (rtp->ssrc >> 16) & 0xff;
+	hdr[10] = (rtp->ssrc >> 8) & 0xff;
+	hdr[11] = rtp->ssrc & 0xff;
+	rtp->seq++;
+}
+
+// Hand a packet to the outputs, payload is gathered from the caller's buffer (no copy)
+static void rtp_send(RtpCtx* rtp, const unsigned char* hdr, int hdr_len, const unsigned char* payload, int payload_len)
+{
+	if (rtp->callback) {
+		rtp->callback(rtp->callback_arg, hdr, hdr_len, payload, payload_len);
+	}
+	if (rtp->sock != -1) {
+#ifdef _WIN32
+		WSABUF buf[2];
+		DWORD sent;
+		buf[0].buf = (char*)hdr;
+		buf[0].len = hdr_len;
+		buf[1].buf = (char*)payload;
+		buf[1].len = payload_len;
+		if (WSASendTo((SOCKET)rtp->sock, buf, 2, &sent, 0, (struct sockaddr*)rtp->addr, sizeof(struct sockaddr_in), NULL, NULL) != 0)
+			printf("ERROR: rtp send failed\n");
+#else
+		struct iovec iov[2];
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		iov[0].iov_base = (void*)hdr;
+		iov[0].iov_len = hdr_len;
+		iov[1].iov_base = (void*)payload;
+		iov[1].iov_len = payload_len;
+		msg.msg_name = rtp->addr;
+		msg.msg_namelen = sizeof(struct sockaddr_in);
+		msg.msg_iov = iov;
+		msg.msg_iovlen = 2;
+		if (sendmsg((int)rtp->sock, &msg, 0) < 0)
+			printf("ERROR: rtp send failed\n");
+#endif
+	}
+	rtp->num_pkt++;
+	rtp->num_bytes += hdr_len + payload_len;
+}
+
+// Send the pending aggregation, a lone nal goes out as a single nal unit packet
+void gg_rtp_flush(RtpCtx* rtp, int marker)
+{
+	if (rtp->pkt_nals == 1) {
+		unsigned char hdr[12];
+		rtp_header(rtp, hdr, marker);
+		rtp_send(rtp, hdr, 12, &rtp->pkt[12 + 1 + 2], rtp->pkt_len - (12 + 1 + 2));
+		rtp->num_single++;
+	}
+	else if (rtp->pkt_nals > 1) {
+		rtp_header(rtp, rtp->pkt, marker);
+		rtp_send(rtp, rtp->pkt, rtp->pkt_len, NULL, 0);
+		rtp->num_stap++;
+	}
+	rtp->pkt_len = 0;
+	rtp->pkt_nals = 0;
+}
+
+// Packetize one nal unit (without start code), au_end marks the last nal of the access unit
+void gg_rtp_put_nal(RtpCtx* rtp, const unsigned char* nal, int len, int au_end)
+{
+	// STAP-A: aggregate nals that fit in a packet, sent when full or at end of access unit
+	if (rtp->stap_flag && 12 + 1 + 2 + len <= rtp->mtu) {
+		if (rtp->pkt_nals && rtp->pkt_len + 2 + len > rtp->mtu) {
+			gg_rtp_flush(rtp, 0);
+		}
+		if (rtp->pkt_nals == 0) {
+			rtp->pkt[12] = NAL_TYPE_STAP_A;
+			rtp->pkt_len = 12 + 1;
+		}
+		rtp->pkt[12] = ((rtp->pkt[12] | nal[0]) & 0x80) | MAX(rtp->pkt[12] & 0x60, nal[0] & 0x60) | NAL_TYPE_STAP_A; // F is or'd, NRI is max
+		rtp->pkt[rtp->pkt_len++] = (len >> 8) & 0xff;
+		rtp->pkt[rtp->pkt_len++] = len & 0xff;
+		memcpy(&rtp->pkt[rtp->pkt_len], nal, len);
+		rtp->pkt_len += len;
+		rtp->pkt_nals++;
+		if (au_end) {
+			gg_rtp_flush(rtp, 1);
+		}
+		return;
+	}
+
+	// Keep nal order, anything pending goes first
+	gg_rtp_flush(rtp, 0);
+
+	if (12 + len <= rtp->mtu) { // Single nal unit packet
+		unsigned char hdr[12];
+		rtp_header(rtp, hdr, au_end);
+		rtp_send(rtp, hdr, 12, nal, len);
+		rtp->num_single++;
+	}
+	else { // FU-A, nal header is carried in the FU indicator/header
+		unsigned char hdr[14];
+		int max_frag = rtp->mtu - 14;
+		for (int pos = 1; pos < len; ) {
+			int frag = MIN(max_frag, len - pos);
+			int last = (pos + frag == len) ? 1 : 0;
+			rtp_header(rtp, hdr, last && au_end);
+			hdr[12] = (nal[0] & 0xe0) | NAL_TYPE_FU_A; // FU indicator F,NRI
+			hdr[13] = ((pos == 1) ? 0x80 : 0) | ((last) ? 0x40 : 0) | (nal[0] & 0x1f); // FU header S,E,type
+			rtp_send(rtp, hdr, 14, nal + pos, frag);
+			pos += frag;
+		}
+		rtp->num_fu++;
+	}
+}
+
+void gg_rtp_close(RtpCtx* rtp)
+{
+	gg_rtp_flush(rtp, 0);
+	printf("RTP: %d packets, %lld bytes, nals: %d single %d fu-a, %d stap-a packets\n", rtp->num_pkt, rtp->num_bytes, rtp->num_single, rtp->num_fu, rtp->num_stap);
+	if (rtp->sock != -1) {
+#ifdef _WIN32
+		closesocket((SOCKET)rtp->sock);
+		WSACleanup();
+#else
+		close((int)rtp->sock);
+#endif
+		rtp->sock = -1;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// RTP payload format for H.264 (RFC 6184), non-interleaved mode
+// Single NAL unit packets, STAP-A aggregation of small NALs, FU-A fragmentation of large NALs
+
+#define GG_RTP_MAX_PKT 1500 // max packet size (12 byte rtp header + payload)
+#define GG_RTP_MIN_PKT 64 // smaller mtus are raised to this, FU-A needs room past its 14 header bytes
+
+// Packets are passed as header (rtp header + payload headers) and payload parts, so nal bytes are not copied
+typedef void (*RtpPacketFn)(void* arg, const unsigned char* hdr, int hdr_len, const unsigned char* payload, int payload_len);
+
+typedef struct _RtpCtx {
+
+	// Session Params
+	int mtu; // max rtp packet size in bytes, header included
+	int payload_type;
+	int stap_flag; // 1-aggregate small nals into STAP-A packets
+	unsigned int ssrc;
+	unsigned short seq;
+	unsigned int timestamp; // 90 kHz, set per access unit
+
+	// Outputs, packets go to the callback and/or the UDP socket
+	RtpPacketFn callback;
+	void* callback_arg;
+	long long sock; // -1 if no socket
+	unsigned char addr[16]; // sockaddr_in of localhost destination
+
+	// Pending STAP-A aggregation packet
+	unsigned char pkt[GG_RTP_MAX_PKT];
+	int pkt_len; // 0 if nothing pending
+	int pkt_nals; // nals in pending packet
+
+	// Stats
+	int num_pkt;
+	int num_single;
+	int num_stap;
+	int num_fu; // nals sent as FU-A fragments
+	long long num_bytes;
+
+} RtpCtx;
+
+void gg_rtp_init(RtpCtx* rtp, int mtu, int payload_type, int stap_flag, unsigned int ssrc, RtpPacketFn callback, void* callback_arg);
+int gg_rtp_open_udp(RtpCtx* rtp, int port);
+void gg_rtp_set_timestamp(RtpCtx* rtp, unsigned int timestamp);
+void gg_rtp_put_nal(RtpCtx* rtp, const unsigned char* nal, int len, int au_end);
+void gg_rtp_flush(RtpCtx* rtp, int marker);
+void gg_rtp_close(RtpCtx* rtp);
@@ -0,0 +1,250 @@
+#define _CRT_SECURE_NO_WARNINGS 1
+#include <stdio.h>
+#include <string.h>
+#include "gg_shm.h"
+
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+
+#define GG_SHM_WAIT_NS 100000000 // 100 ms, recheck eos and the peer
+
+static unsigned int shm_load(unsigned int* p) { return(__atomic_load_n(p, __ATOMIC_ACQUIRE)); }
+static void shm_store(unsigned int* p, unsigned int val) { __atomic_store_n(p, val, __ATOMIC_RELEASE); }
+
+// Sleep while *p == val (shared futex, the ring is mapped in two processes)
+static void shm_wait(unsigned int* p, unsigned int val)
+{
+	struct timespec ts = { 0, GG_SHM_WAIT_NS };
+	syscall(SYS_futex, p, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+// Peer process gone (pid 0: not attached yet, counts as alive)
+static int shm_dead(int pid)
+{
+	return(pid > 0 && kill(pid, 0) < 0 && errno == ESRCH);
+}
+
+static void shm_wake(unsigned int* p)
+{
+	syscall(SYS_futex, p, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+static int shm_map(ShmRing* ring, const char* name, long long len)
+{
+	ring->base = (unsigned char*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (ring->base == MAP_FAILED) {
+		ring->base = NULL;
+		printf("ERROR: could not map shared memory %s\n", name);
+		return(-1);
+	}
+	ring->len = len;
+	ring->hdr = (ShmRingHdr*)ring->base;
+	return(0);
+}
+
+// Bytes of one picture in a slot, chroma pitch follows the luma pitch as in gg_input
+static long long shm_frame_size(int height, int stride_y, int format)
+{
+	int stride_c = (format == GG_YUV_NV12) ? stride_y : stride_y >> 1;
+	return((long long)stride_y * height + (long long)stride_c * (height >> 1) * ((format == GG_YUV_NV12) ? 1 : 2));
+}
+
+int gg_shm_create(ShmRing* ring, const char* name, int width, int height, int stride, int format, int num_slots, int fps_num, int fps_den)
+{
+	long long page = sysconf(_SC_PAGESIZE);
+	int stride_y = (stride) ? stride : width;
+	int stride_c = (format == GG_YUV_NV12) ? stride_y : stride_y >> 1;
+	long long frame_size = shm_frame_size(height, stride_y, format);
+	long long hdr_size = (sizeof(ShmRingHdr) + page - 1) & ~(page - 1);
+	long long slot_size = (frame_size + page - 1) & ~(page - 1);
+	ShmRingHdr* hdr;
+
+	memset(ring, 0, sizeof(ShmRing));
+	ring->fd = -1;
+	if (num_slots < 2 || num_slots > GG_SHM_MAX_SLOTS) {
+		printf("ERROR: shared memory ring needs 2..%d slots\n", GG_SHM_MAX_SLOTS);
+		return(-1);
+	}
+	strncpy(ring->name, name, sizeof(ring->name) - 1);
+	ring->owner = 1;
+	ring->fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (ring->fd < 0 || ftruncate(ring->fd, hdr_size + slot_size * num_slots) < 0) {
+		printf("ERROR: could not create shared memory %s\n", name);
+		gg_shm_close(ring);
+		return(-1);
+	}
+	if (shm_map(ring, name, hdr_size + slot_size * num_slots)) {
+		gg_shm_close(ring);
+		return(-1);
+	}
+	hdr = ring->hdr;
+	hdr->version = GG_SHM_VERSION;
+	hdr->hdr_size = (unsigned int)hdr_size;
+	hdr->slot_size = (unsigned int)slot_size;
+	hdr->num_slots = num_slots;
+	hdr->width = width;
+	hdr->height = height;
+	hdr->stride_y = stride_y;
+	hdr->stride_c = stride_c;
+	hdr->format = format;
+	hdr->fps_num = fps_num;
+	hdr->fps_den = fps_den;
+	hdr->producer_pid = (int)getpid();
+	shm_store(&hdr->magic, GG_SHM_MAGIC); // published last, attach checks it
+	return(0);
+}
+
+unsigned char* gg_shm_write_slot(ShmRing* ring)
+{
+	ShmRingHdr* hdr = ring->hdr;
+	unsigned int rd;
+	if ((unsigned int)(hdr->write_seq - shm_load(&hdr->read_seq)) >= (unsigned int)hdr->num_slots) {
+		ring->num_waits++;
+		while ((unsigned int)(hdr->write_seq - (rd = shm_load(&hdr->read_seq))) >= (unsigned int)hdr->num_slots) {
+			if (shm_dead(__atomic_load_n(&hdr->consumer_pid, __ATOMIC_ACQUIRE))) {
+				printf("ERROR: shared memory consumer %d exited\n", hdr->consumer_pid);
+				return(NULL);
+			}
+			shm_wait(&hdr->read_seq, rd);
+		}
+	}
+	return(ring->base + hdr->hdr_size + (long long)(hdr->write_seq % hdr->num_slots) * hdr->slot_size);
+}
+
+void gg_shm_publish(ShmRing* ring, unsigned long long frame_num)
+{
+	ShmRingHdr* hdr = ring->hdr;
+	hdr->frame_num[hdr->write_seq % hdr->num_slots] = frame_num;
+	shm_store(&hdr->write_seq, hdr->write_seq + 1);
+	shm_wake(&hdr->write_seq);
+	ring->num_frames++;
+}
+
+void gg_shm_end(ShmRing* ring)
+{
+	shm_store(&ring->hdr->eos, 1);
+	shm_wake(&ring->hdr->write_seq);
+}
+
+int gg_shm_attach(ShmRing* ring, const char* name)
+{
+	struct stat st;
+	ShmRingHdr* hdr;
+
+	memset(ring, 0, sizeof(ShmRing));
+	ring->fd = -1;
+	strncpy(ring->name, name, sizeof(ring->name) - 1);
+	ring->fd = shm_open(name, O_RDWR, 0);
+	if (ring->fd < 0 || fstat(ring->fd, &st) < 0 || st.st_size < (long long)sizeof(ShmRingHdr)) {
+		printf("ERROR: could not open shared memory %s\n", name);
+		gg_shm_close(ring);
+		return(-1);
+	}
+	if (shm_map(ring, name, st.st_size)) {
+		gg_shm_close(ring);
+		return(-1);
+	}
+	hdr = ring->hdr;
+	if (shm_load(&hdr->magic) != GG_SHM_MAGIC || hdr->version != GG_SHM_VERSION ||
+		hdr->num_slots < 2 || hdr->num_slots > GG_SHM_MAX_SLOTS ||
+		hdr->hdr_size + (long long)hdr->slot_size * hdr->num_slots > ring->len) {
+		printf("ERROR: %s is not a frame ring\n", name);
+		gg_shm_close(ring);
+		return(-1);
+	}
+	// The encoder trusts the picture layout, a frame must fit in its slot
+	if (hdr->width <= 0 || hdr->height <= 0 || (hdr->width & 1) || (hdr->height & 1) || hdr->stride_y < hdr->width ||
+		(hdr->format != GG_YUV_I420 && hdr->format != GG_YUV_NV12) || shm_frame_size(hdr->height, hdr->stride_y, hdr->format) > hdr->slot_size) {
+		printf("ERROR: frame ring %s has a bad picture layout %dx%d stride %d format %d slot %u\n", name, hdr->width, hdr->height, hdr->stride_y, hdr->format, hdr->slot_size);
+		gg_shm_close(ring);
+		return(-1);
+	}
+	__atomic_store_n(&hdr->consumer_pid, (int)getpid(), __ATOMIC_RELEASE);
+	ring->next_frame_num = hdr->frame_num[hdr->read_seq % hdr->num_slots];
+	return(0);
+}
+
+unsigned char* gg_shm_acquire(ShmRing* ring)
+{
+	ShmRingHdr* hdr = ring->hdr;
+	unsigned int slot, wr;
+
+	if (ring->held)
+		gg_shm_release(ring);
+	if (shm_load(&hdr->write_seq) == hdr->read_seq) {
+		ring->num_waits++;
+		while ((wr = shm_load(&hdr->write_seq)) == hdr->read_seq) {
+			if (shm_load(&hdr->eos))
+				return(NULL);
+			if (shm_dead(hdr->producer_pid)) {
+				printf("ERROR: shared memory producer %d exited without ending the stream\n", hdr->producer_pid);
+				return(NULL);
+			}
+			shm_wait(&hdr->write_seq, wr);
+		}
+	}
+	slot = hdr->read_seq % hdr->num_slots;
+	if (hdr->frame_num[slot] != ring->next_frame_num)
+		ring->num_gaps += (int)(hdr->frame_num[slot] - ring->next_frame_num);
+	ring->next_frame_num = hdr->frame_num[slot] + 1;
+	ring->held = 1;
+	ring->num_frames++;
+	return(ring->base + hdr->hdr_size + (long long)slot * hdr->slot_size);
+}
+
+// Hand the slot back to the producer
+void gg_shm_release(ShmRing* ring)
+{
+	if (ring->held) {
+		shm_store(&ring->hdr->read_seq, ring->hdr->read_seq + 1);
+		shm_wake(&ring->hdr->read_seq);
+		ring->held = 0;
+	}
+}
+
+void gg_shm_close(ShmRing* ring)
+{
+	if (ring->hdr && !ring->owner)
+		gg_shm_release(ring);
+	if (ring->base)
+		munmap(ring->base, ring->len);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	if (ring->owner)
+		shm_unlink(ring->name);
+	ring->base = NULL;
+	ring->hdr = NULL;
+	ring->fd = -1;
+}
+
+#else // no futex shared memory ring on this platform
+
+int gg_shm_create(ShmRing* ring, const char* name, int width, int height, int stride, int format, int num_slots, int fps_num, int fps_den)
+{
+	memset(ring, 0, sizeof(ShmRing));
+	printf("ERROR: shared memory frame ring not supported on this platform\n");
+	return(-1);
+}
+unsigned char* gg_shm_write_slot(ShmRing* ring) { return(NULL); }
+void gg_shm_publish(ShmRing* ring, unsigned long long frame_num) { }
+void gg_shm_end(ShmRing* ring) { }
+int gg_shm_attach(ShmRing* ring, const char* name)
+{
+	memset(ring, 0, sizeof(ShmRing));
+	printf("ERROR: shared memory frame ring not supported on this platform\n");
+	return(-1);
+}
+unsigned char* gg_shm_acquire(ShmRing* ring) { return(NULL); }
+void gg_shm_release(ShmRing* ring) { }
+void gg_shm_close(ShmRing* ring) { }
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+// Shared memory frame ring between a capture process (producer) and the encoder (consumer)
+// POSIX shm object: a header page followed by num_slots page aligned 4:2:0 frame slots.
+// The producer fills slot (write_seq % num_slots) while write_seq - read_seq < num_slots, then bumps write_seq.
+// The encoder codes straight from the slot pages and bumps read_seq once the last row has been read.
+// write_seq and read_seq are futex words (Linux). Waits time out every 100 ms to check the peer process is still
+// alive (pid stored in the header), a wait on a dead peer gives up.
+
+#define GG_SHM_MAGIC 0x4d485347 // "GSHM"
+#define GG_SHM_VERSION 3
+#define GG_SHM_MAX_SLOTS 16
+
+// 4:2:0 layouts (also used by gg_input)
+#define GG_YUV_I420 0 // planar y, cb, cr
+#define GG_YUV_NV12 1 // planar y, interleaved cb/cr
+
+typedef struct _ShmRingHdr {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int hdr_size; // offset of slot 0
+	unsigned int slot_size; // bytes per slot, page multiple
+	int num_slots;
+	int width; // luma samples
+	int height;
+	int stride_y; // row pitch within a slot
+	int stride_c;
+	int format; // GG_YUV_I420 or GG_YUV_NV12
+	int fps_num; // 0 if unknown
+	int fps_den;
+	unsigned int write_seq; // frames published by the producer
+	unsigned int read_seq; // frames released by the encoder
+	unsigned int eos; // producer finished
+	int producer_pid; // liveness of each side, 0 until the consumer attaches
+	int consumer_pid;
+	unsigned long long frame_num[GG_SHM_MAX_SLOTS]; // capture frame number held in each slot
+} ShmRingHdr;
+
+typedef struct _ShmRing {
+	ShmRingHdr* hdr;
+	unsigned char* base; // mapping
+	long long len;
+	int fd;
+	int owner; // 1-created by this process, unlinked on close
+	char name[64];
+	int held; // consumer holds slot (read_seq % num_slots)
+
+	// Stats
+	unsigned long long next_frame_num; // expected capture frame number
+	int num_frames;
+	int num_gaps; // capture frames never seen by the encoder
+	int num_waits; // times a side waited on the other
+} ShmRing;
+
+// Producer
+int gg_shm_create(ShmRing* ring, const char* name, int width, int height, int stride, int format, int num_slots, int fps_num, int fps_den);
+unsigned char* gg_shm_write_slot(ShmRing* ring); // waits for a free slot, NULL if the consumer died
+void gg_shm_publish(ShmRing* ring, unsigned long long frame_num);
+void gg_shm_end(ShmRing* ring);
+
+// Consumer
+int gg_shm_attach(ShmRing* ring, const char* name);
+unsigned char* gg_shm_acquire(ShmRing* ring); // waits for the next frame, NULL at end of stream or if the producer died
+void gg_shm_release(ShmRing* ring);
+
+void gg_shm_close(ShmRing* ring);
@@ -0,0 +1,45 @@
+#pragma once
+
+// Minimal thread, mutex, condition variable wrappers (win32 or pthreads)
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE gg_thread_t;
+typedef CRITICAL_SECTION gg_mutex_t;
+typedef CONDITION_VARIABLE gg_cond_t;
+typedef DWORD gg_thread_ret;
+#define GG_THREAD_CALL WINAPI
+
+static inline int gg_thread_create(gg_thread_t* t, gg_thread_ret (GG_THREAD_CALL *fn)(void*), void* arg) { *t = CreateThread(NULL, 0, fn, arg, 0, NULL); return((*t) ? 0 : -1); }
+static inline void gg_thread_join(gg_thread_t t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+static inline void gg_mutex_init(gg_mutex_t* m) { InitializeCriticalSection(m); }
+static inline void gg_mutex_destroy(gg_mutex_t* m) { DeleteCriticalSection(m); }
+static inline void gg_mutex_lock(gg_mutex_t* m) { EnterCriticalSection(m); }
+static inline void gg_mutex_unlock(gg_mutex_t* m) { LeaveCriticalSection(m); }
+static inline void gg_cond_init(gg_cond_t* c) { InitializeConditionVariable(c); }
+static inline void gg_cond_destroy(gg_cond_t* c) { (void)c; }
+static inline void gg_cond_wait(gg_cond_t* c, gg_mutex_t* m) { SleepConditionVariableCS(c, m, INFINITE); }
+static inline void gg_cond_broadcast(gg_cond_t* c) { WakeAllConditionVariable(c); }
+
+#else
+#include <pthread.h>
+
+typedef pthread_t gg_thread_t;
+typedef pthread_mutex_t gg_mutex_t;
+typedef pthread_cond_t gg_cond_t;
+typedef void* gg_thread_ret;
+#define GG_THREAD_CALL
+
+static inline int gg_thread_create(gg_thread_t* t, gg_thread_ret (GG_THREAD_CALL *fn)(void*), void* arg) { return(pthread_create(t, NULL, fn, arg)); }
+static inline void gg_thread_join(gg_thread_t t) { pthread_join(t, NULL); }
+static inline void gg_mutex_init(gg_mutex_t* m) { pthread_mutex_init(m, NULL); }
+static inline void gg_mutex_destroy(gg_mutex_t* m) { pthread_mutex_destroy(m); }
+static inline void gg_mutex_lock(gg_mutex_t* m) { pthread_mutex_lock(m); }
+static inline void gg_mutex_unlock(gg_mutex_t* m) { pthread_mutex_unlock(m); }
+static inline void gg_cond_init(gg_cond_t* c) { pthread_cond_init(c, NULL); }
+static inline void gg_cond_destroy(gg_cond_t* c) { pthread_cond_destroy(c); }
+static inline void gg_cond_wait(gg_cond_t* c, gg_mutex_t* m) { pthread_cond_wait(c, m); }
+static inline void gg_cond_broadcast(gg_cond_t* c) { pthread_cond_broadcast(c); }
+
+#endif
@@ -0,0 +1,113 @@
+#define _CRT_SECURE_NO_WARNINGS 1
+#include <stdio.h>
+#include <string.h>
+#include "gg_yuvout.h"
+
+static void yuvout_write(YuvWriter* out, RefPic* pic)
+{
+	size_t w = out->width;
+	size_t n = 0;
+	for (int yy = 0; yy < out->height; yy++)
+		n += fwrite(pic->y + (size_t)yy * out->mgr->stride_y, 1, w, out->fp);
+	for (int yy = 0; yy < (out->height >> 1); yy++)
+		n += fwrite(pic->cb + (size_t)yy * out->mgr->stride_c, 1, w >> 1, out->fp);
+	for (int yy = 0; yy < (out->height >> 1); yy++)
+		n += fwrite(pic->cr + (size_t)yy * out->mgr->stride_c, 1, w >> 1, out->fp);
+	if (n != w * out->height + (w >> 1) * out->height)
+		out->num_errors++;
+	out->num_frames++;
+}
+
+// Writer thread, drains the queue in order until closed
+static gg_thread_ret GG_THREAD_CALL yuvout_thread(void* arg)
+{
+	YuvWriter* out = (YuvWriter*)arg;
+	RefPic* pic;
+
+	for (;;) {
+		gg_mutex_lock(&out->lock);
+		while (!out->q_len && !out->stop)
+			gg_cond_wait(&out->cond, &out->lock);
+		if (!out->q_len) {
+			gg_mutex_unlock(&out->lock);
+			break;
+		}
+		pic = out->queue[out->q_head];
+		gg_mutex_unlock(&out->lock);
+
+		yuvout_write(out, pic);
+		gg_refpic_release(out->mgr, pic);
+
+		gg_mutex_lock(&out->lock);
+		out->q_head = (out->q_head + 1) % GG_YUVOUT_QUEUE;
+		out->q_len--;
+		gg_cond_broadcast(&out->cond);
+		gg_mutex_unlock(&out->lock);
+	}
+	return(0);
+}
+
+int gg_yuvout_open(YuvWriter* out, const char* name, RefPicMgr* mgr, int async_flag)
+{
+	memset(out, 0, sizeof(YuvWriter));
+	out->mgr = mgr;
+	out->width = mgr->width;
+	out->height = mgr->height;
+	out->fp = fopen(name, "wb");
+	if (!out->fp) {
+		printf("ERROR: could not open recon output %s\n", name);
+		return(-1);
+	}
+	setvbuf(out->fp, NULL, _IOFBF, 1 << 20); // rows are gathered into large writes
+	if (async_flag) {
+		gg_mutex_init(&out->lock);
+		gg_cond_init(&out->cond);
+		if (gg_thread_create(&out->thread, yuvout_thread, out)) {
+			printf("Warning: no recon writer thread, writing inline\n");
+			gg_cond_destroy(&out->cond);
+			gg_mutex_destroy(&out->lock);
+			async_flag = 0;
+		}
+	}
+	out->async_flag = async_flag;
+	return(0);
+}
+
+// Output a coded picture, queued (holding a reference) in async mode
+void gg_yuvout_put(YuvWriter* out, RefPic* pic)
+{
+	if (!out->fp)
+		return;
+	if (!out->async_flag) {
+		yuvout_write(out, pic);
+		return;
+	}
+	gg_refpic_addref(out->mgr, pic);
+	gg_mutex_lock(&out->lock);
+	while (out->q_len == GG_YUVOUT_QUEUE)
+		gg_cond_wait(&out->cond, &out->lock);
+	out->queue[(out->q_head + out->q_len) % GG_YUVOUT_QUEUE] = pic;
+	out->q_len++;
+	gg_cond_broadcast(&out->cond);
+	gg_mutex_unlock(&out->lock);
+}
+
+// Flush queued pictures and close the file
+void gg_yuvout_close(YuvWriter* out)
+{
+	if (!out->fp)
+		return;
+	if (out->async_flag) {
+		gg_mutex_lock(&out->lock);
+		out->stop = 1;
+		gg_cond_broadcast(&out->cond);
+		gg_mutex_unlock(&out->lock);
+		gg_thread_join(out->thread);
+		gg_cond_destroy(&out->cond);
+		gg_mutex_destroy(&out->lock);
+	}
+	fclose(out->fp);
+	out->fp = NULL;
+	if (out->num_errors)
+		printf("ERROR: recon output, %d frames failed to write\n", out->num_errors);
+}
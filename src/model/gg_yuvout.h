@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include "gg_thread.h"
+#include "gg_refpic.h"
+
+// Reconstructed yuv output for validation
+// Pictures are refcounted manager buffers, in async mode a writer thread writes them
+// through a large stdio buffer and releases them, so the encoder only queues a pointer.
+
+#define GG_YUVOUT_QUEUE GG_REFPIC_POOL
+
+typedef struct _YuvWriter {
+	FILE* fp;
+	RefPicMgr* mgr;
+	int async_flag;
+	int width;
+	int height;
+
+	// Writer thread queue
+	gg_thread_t thread;
+	gg_mutex_t lock;
+	gg_cond_t cond;
+	RefPic* queue[GG_YUVOUT_QUEUE];
+	int q_head;
+	int q_len;
+	int stop;
+
+	// Stats
+	int num_frames;
+	int num_errors;
+} YuvWriter;
+
+int gg_yuvout_open(YuvWriter* out, const char* name, RefPicMgr* mgr, int async_flag);
+void gg_yuvout_put(YuvWriter* out, RefPic* pic);
+void gg_yuvout_close(YuvWriter* out);
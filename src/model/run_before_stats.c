@@ -0,0 +1,107 @@
+// run_before_stats.c : Worst case CAVLC total_zeros + run_before lengths over all 4x4 significance maps.
+// Prints each map that sets a new maximum, then the maximum bits of every window of consecutive codes
+// (sizing of the hardware bit packer). Formerly run at encoder startup.
+//
+// Build: run_before_stats.c gg_process_tables.c
+
+#include <stdio.h>
+#include "gg_process.h"
+
+int main()
+{
+	vlc_t vlc_run_before[15]; // 0th is total_zero's and then 14 run befores
+	int test;
+	int total_zeros;
+	int num_coeff;
+	int zeros;
+	int run;
+	int last_sig;
+	int scan[16];
+	int bitcount;
+	int max_bits;
+	int max_bits_n[15][15];
+
+	max_bits = 0;
+	for (int ii = 0; ii < 15; ii++)
+		for (int jj = 0; jj < 15; jj++)
+			max_bits_n[ii][jj] = 0;
+
+	for (test = 1; test < 65534; test++) {
+		// Setup scan
+		for (int ii = 0; ii < 16; ii++) 
+			scan[ii] = (test & (1 << ii)) ? 1 : 0;
+		// clear VLCs //
+		for (int ii = 0; ii < 15; ii++) {
+			vlc_run_before[ii].i_size = 0;
+			vlc_run_before[ii].i_bits = 0;
+		}
+		// Calc num_coeff
+		num_coeff = 0;
+		for (int ii = 0; ii < 16; ii++)
+			num_coeff += (scan[ii]) ? 1 : 0;
+		// Calc total_zero's, last_sig
+		for (last_sig = 16; scan[last_sig - 1] == 0; last_sig--);
+		total_zeros = last_sig - num_coeff;
+		// COde Total Zeros's
+		if (num_coeff == 16 || num_coeff == 0) {
+			vlc_run_before[0].i_bits = 0;
+			vlc_run_before[0].i_size = 0;
+		}
+		else { // use table 9-7, 9-8
+			vlc_run_before[0] = gg_vlc(gg_cavlc.total_zeros[num_coeff - 1][total_zeros]);
+		}
+		// Determine run before
+		zeros = total_zeros;
+		run = 0;
+		if (num_coeff > 1 && total_zeros) {
+			for (int coeff_idx = last_sig - 2, sig_count = 0; (sig_count < num_coeff - 1) && zeros; coeff_idx--) {
+				if (scan[coeff_idx]) {
+					vlc_run_before[sig_count+1] = gg_vlc(gg_cavlc.run_before[MIN(zeros - 1, 6)][run]);
+					sig_count++;
+					zeros -= run;
+					run = 0;
+				}
+				else {
+					run++;
+				}
+			}
+		}
+		// Count bits
+		bitcount = 0;
+		for (int ii = 0; ii < 15; bitcount += vlc_run_before[ii++].i_size);
+		if (bitcount > max_bits) {
+			// Print VLC
+			printf("%04x = %3d nc %2d tz %2d  : ", test, bitcount, num_coeff, total_zeros );
+			for (int ii = 0; ii < 15; ii++)
+				if (vlc_run_before[ii].i_size) {
+					for (int bb = vlc_run_before[ii].i_size - 1; bb >= 0; bb--)
+						printf("%d", (vlc_run_before[ii].i_bits >> bb) & 1);
+					printf(" ");
+				}
+			printf("\n");
+		}
+		max_bits = MAX(bitcount, max_bits);
+
+		// Accumulated max_bits_n 
+
+		for ( int acc_len = 0; acc_len < 15; acc_len++) {
+			for (int acc_off = 0; acc_off < (15 - acc_len); acc_off++) {
+				int sum = 0;
+				for (int idx = 0; idx < acc_len+1; idx++) {
+					sum += vlc_run_before[idx + acc_off].i_size;
+				}
+				max_bits_n[acc_len][acc_off] = MAX(sum, max_bits_n[acc_len][acc_off]);
+			}
+		}
+	} // test
+	printf("Max length run before = %d\n", max_bits);
+
+	// Print summary
+	for (int ii = 0; ii < 15; ii++) {
+		printf("sum window = %2d : ", ii + 1);
+		for (int jj = 0; jj < (15 - ii); jj++)
+			printf("%2d ", max_bits_n[ii][jj]);
+		printf("\n");
+	}
+	return(0);
+}
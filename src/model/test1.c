@@ -3,71 +3,144 @@
 
 #define _CRT_SECURE_NO_WARNINGS 1
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "gg_process.h"
 #include "gg_deblock.h"
+#include "gg_rtp.h"
+#include "gg_input.h"
+#include "gg_refpic.h"
+#include "gg_yuvout.h"
+#include "gg_alloc.h"
+#include "gg_dist.h"
+#include "gg_me.h"
 
 //#define INPUT_YUV "cheer_if.yuv"
 //#define PIC_WIDTH 720
 //#define PIC_HEIGHT 480
 
+// Defaults, overridden on the command line: test1 [input.yuv width height [stride]]
 #define INPUT_YUV "foreman_qcif.yuv"
 #define PIC_WIDTH 176
 #define PIC_HEIGHT 144
 
+int pic_width = PIC_WIDTH;
+int pic_height = PIC_HEIGHT;
 int mb_width = PIC_WIDTH>>4;
 int mb_height = PIC_HEIGHT>>4;
 
 // Parameters 
 int row_slice_flag = 1;
+int mtu_slice_bytes = 0; // 0-off, else NAL byte budget per slice (e.g. 1388, a 1400 byte RTP packet less its 12 byte header), best effort: see GGO_EMU_RESERVE
 int disable_deblocking_filter_idc = 1; // 0-enable, 1-disable, 2-disable across slices boundaries
 int pintra_disable_deblocking_filter_idc = 0; // pintra frames :0-enable, 1-disable, 2-disable across slices boundaries
 int filterOffsetA = 0;
 int filterOffsetB = 0;
+int avcc_flag = 0; // 0-Annex B start codes, 1-4 byte NAL length prefixes plus avcC record (MP4 sample format)
+int rtp_flag = 0; // 1-also packetize NALs as RTP (RFC 6184) to a localhost UDP port
+int rtp_port = 5004;
+int rtp_mtu = 1400; // max RTP packet bytes, larger NALs are sent as FU-A fragments
+int recon_flag = 1; // 1-write the reconstructed yuv (validation), 0-skip it (production)
+int recon_async_flag = 1; // 1-recon written by a background writer thread
+int deblock_mode = GG_DEBLOCK_FAST; // GG_DEBLOCK_FAST-frame buffer edge engine (production), GG_DEBLOCK_RING-hardware order model (RTL vectors)
+int deblock_async_flag = 1; // 1-fast deblocking runs on its own thread, a macroblock row behind the encoder
+int hugepage_flag = 0; // 1-frame stores on huge pages
+int numa_node = -1; // frame stores bound to: -1 node of the encoding thread, -2 no binding, else this node
+int raster_flag = 0; // 1-input arrives in macroblock row strips (raster camera model), rows are coded as they arrive
+int input_nv12_flag = 0; // 1-raw input file is NV12 (interleaved cb/cr plane), read in place without repacking
+int psnr_flag = 1; // 1-report recon PSNR against the input, waits for each picture to be fully deblocked
+int dist_level = GG_DIST_AUTO; // distortion kernels: GG_DIST_AUTO, _SCALAR, _SSE2 or _AVX2
+int me_range = 16; // integer motion search window, +-luma samples, 0-every mv zero (co-located prediction)
+int me_subpel = 1; // 1-half and quarter sample refinement of the searched mv, refs carry precomputed half sample planes
+int me_pyramid = 1; // 1-coarse to fine search on 2x and 4x downsampled luma seeds the integer search (large me_range)
 
 FILE* ggo_fp;
 int ggo_bitpos;
 char ggo_char;
 int ggo_obc;
 
+// NAL unit buffer, each NAL is completed here before going to the outputs
+// The 4 bytes ahead of the NAL take its start code or length prefix, so it is written with one fwrite
+unsigned char* ggo_nal_buf; // sized for max 3088 bits (386 bytes) per mb, 3/2 for emulation prevention, plus headers
+unsigned char* ggo_nal;
+int ggo_nal_len;
+int ggo_nal_sc_len; // start code length, 3 or 4
+RtpCtx ggo_rtp;
+// Latest parameter sets, for the avcC record
+unsigned char ggo_sps[256], ggo_pps[256];
+int ggo_sps_len, ggo_pps_len;
+int ggo_rtp_ts_inc = 3000; // 90 kHz clock, 30 fps unless the input gives a frame rate
+
 int ggo_frame;
 int ggo_intra_col;
 
 int ggo_prev_zero; // count of previous zero's
 
 DeblockCtx dbp; // Deblock private data
-
-// orig image
-FILE* ggi_fp;
-char ggi_y[1920 * 1088];
-char ggi_cb[1920 * 1088 / 4];
-char ggi_cr[1920 * 1088 / 4];
+MeCtx ggo_me; // motion search and the mvs of the picture
+
+// orig image, points into the input mapping or reader buffer
+YuvInput ggi;
+YuvFrame ggi_frame; // current picture, planes stay in the input buffer (I420 or NV12)
+unsigned char ggi_mb_y[256], ggi_mb_cb[64], ggi_mb_cr[64]; // source samples of the current macroblock
+YuvInput ggi_src; // raster mode: source file pushed in strips by the capture thread
+gg_thread_t ggi_capture;
+void ggi_wait_row(int mb_row);
+void ggi_row_done(int mb_row);
 // recon image
-FILE* ggo_recon_fp;
-char ggo_recon_y[1920 * 1088];
-char ggo_recon_cb[1920 * 1088 / 4];
-char ggo_recon_cr[1920 * 1088 / 4];
-// Reference pictures
-char ggo_ref_y[2][1920 * 1088];
-char ggo_ref_cb[2][1920 * 1088 / 4];
-char ggo_ref_cr[2][1920 * 1088 / 4];
-// recon stats
-char recon_mb_stat[3][1920 * 1088 / 256];    // 0-qp, 1-refidx, 2-pcm
-char recon_nz_y[1920 * 1088 / 16];  // non-zero coeffs in blk
-char recon_nz_cb[1920 * 1088 / 64];
-char recon_nz_cr[1920 * 1088 / 64];
-
-
-
-
-void ggo_init(const char* name)
+YuvWriter ggo_recon_out;
+char* ggo_recon_y;
+char* ggo_recon_cb;
+char* ggo_recon_cr;
+// Reference pictures, recon and refs are buffers owned by the reference picture manager
+RefPicMgr ggo_refpic;
+char* ggo_ref_y[2];
+char* ggo_ref_cb[2];
+char* ggo_ref_cr[2];
+int ggo_stride_y; // recon and ref row pitch
+int ggo_stride_c;
+// above nC contexts, 4 luma and 2+2 chroma per mb
+char* ggo_abvnc;
+
+long long ggo_psnr_ssd[3]; // y, cb, cr totals over the coded pictures
+double ggo_psnr_sum[3];
+int ggo_psnr_frames;
+void psnr_frame();
+MemPool ggo_pool; // frame stores and scratch of this encoder
+
+
+
+
+int ggo_init(const char* name)
 {
+    ggo_nal_buf = (unsigned char*)gg_pool_alloc(&ggo_pool, 4 + (size_t)mb_width * mb_height * 579 + 1024);
+    ggo_abvnc = (char*)gg_pool_alloc(&ggo_pool, (size_t)mb_width * 8);
     ggo_fp = fopen(name, "wb");
+    if (!ggo_nal_buf || !ggo_abvnc || !ggo_fp) {
+        printf("ERROR: could not set up output %s\n", name);
+        return(-1);
+    }
+    ggo_nal = ggo_nal_buf + 4;
     ggo_bitpos = 0;
     ggo_char = 0;
     ggo_obc  = 0;
     ggo_frame = 0;
     ggo_prev_zero = 0;
     ggo_intra_col = 0;
+    ggo_nal_len = 0;
+    ggo_sps_len = 0;
+    ggo_pps_len = 0;
+    if (rtp_flag) {
+        gg_rtp_init(&ggo_rtp, rtp_mtu, 96, 1, 0x67676767, NULL, NULL);
+        if (gg_rtp_open_udp(&ggo_rtp, rtp_port)) {
+            printf("ERROR: could not set up rtp output to port %d\n", rtp_port);
+            return(-1);
+        }
+        // Each slice NAL fits one packet after the 12 byte RTP header
+        if (mtu_slice_bytes > ggo_rtp.mtu - 12)
+            mtu_slice_bytes = ggo_rtp.mtu - 12;
+    }
+    return(0);
 }
 
 
@@ -77,17 +150,22 @@ void ggo_init(const char* name)
 void ggo_close()
 {
     fclose(ggo_fp);
+    gg_pool_free(&ggo_pool, ggo_nal_buf);
+    gg_pool_free(&ggo_pool, ggo_abvnc);
+    if (rtp_flag) {
+        gg_rtp_close(&ggo_rtp);
+    }
 }
 
 void ggo_emulation_prev_putc( char obyte )
 {
     if (ggo_prev_zero == 2 && obyte <= 3) {
-        fputc(0x03, ggo_fp); // emulation prevention
+        ggo_nal[ggo_nal_len++] = 0x03; // emulation prevention
         ggo_obc++;
         ggo_prev_zero = 0;
         printf("*EMU* ");
     }
-    fputc(obyte, ggo_fp);
+    ggo_nal[ggo_nal_len++] = obyte;
     printf("%02x ", obyte & 0xff);
     if (obyte == 0)
         ggo_prev_zero++;
@@ -120,7 +198,7 @@ void ggo_align()
 void ggo_pcm_putbyte(char val)
 {
     //assumes alignment, and no pcm zero's allowed by profile
-    fputc((val == 0) ? 1 : val, ggo_fp);
+    ggo_nal[ggo_nal_len++] = (val == 0) ? 1 : val;
     ggo_obc++;
     ggo_bitpos = 0;
     ggo_prev_zero = 0;
@@ -142,22 +220,82 @@ void ggo_put_start(int len)
         printf("\n");
         ggo_bitpos = 0;
         ggo_char = 0;
-        fputc(0, ggo_fp); 
         printf("%02x ", 0);
-        ggo_obc++;
-        fputc(0, ggo_fp); 
         printf("%02x ", 0);
-        ggo_obc++;
         if (len == 4) {
-            fputc(0, ggo_fp);
             printf("%02x ", 0);
-            ggo_obc++;
         }
-        fputc(1, ggo_fp); 
         printf("%02x ", 1);
-        ggo_obc++;
+        ggo_obc += len;
         ggo_prev_zero = 0; // No emu prev on startcodes
+        ggo_nal_sc_len = len; // start code written with the completed NAL
+        ggo_nal_len = 0;
+    }
+}
+
+// NAL unit is complete in ggo_nal[], write it to the stream with its start code or length prefix, and packetize
+void ggo_nal_end(int au_end)
+{
+    unsigned char* prefix = ggo_nal - 4;
+    if (avcc_flag) { // patch in big endian NAL length
+        prefix[0] = (ggo_nal_len >> 24) & 0xff;
+        prefix[1] = (ggo_nal_len >> 16) & 0xff;
+        prefix[2] = (ggo_nal_len >> 8) & 0xff;
+        prefix[3] = ggo_nal_len & 0xff;
+        fwrite(prefix, 1, 4 + ggo_nal_len, ggo_fp);
+    }
+    else {
+        prefix[0] = 0;
+        prefix[1] = 0;
+        prefix[2] = 0;
+        prefix[3] = 1;
+        fwrite(prefix + 4 - ggo_nal_sc_len, 1, ggo_nal_sc_len + ggo_nal_len, ggo_fp);
     }
+    if ((ggo_nal[0] & 0x1f) == 7 && ggo_nal_len <= sizeof(ggo_sps)) {
+        memcpy(ggo_sps, ggo_nal, ggo_nal_len);
+        ggo_sps_len = ggo_nal_len;
+    }
+    if ((ggo_nal[0] & 0x1f) == 8 && ggo_nal_len <= sizeof(ggo_pps)) {
+        memcpy(ggo_pps, ggo_nal, ggo_nal_len);
+        ggo_pps_len = ggo_nal_len;
+    }
+    if (rtp_flag) {
+        gg_rtp_put_nal(&ggo_rtp, ggo_nal, ggo_nal_len, au_end);
+        if (au_end) {
+            gg_rtp_set_timestamp(&ggo_rtp, ggo_rtp.timestamp + ggo_rtp_ts_inc);
+        }
+    }
+}
+
+// Write the AVCDecoderConfigurationRecord (ISO/IEC 14496-15 avcC) from the latest SPS/PPS
+void ggo_write_avcc(const char* name)
+{
+    FILE* fp;
+    unsigned char hdr[6];
+    if (ggo_sps_len < 4 || ggo_pps_len == 0) {
+        printf("ERROR: avcC needs a SPS and PPS, skipping!!!\n");
+        return;
+    }
+    fp = fopen(name, "wb");
+    if (!fp) {
+        printf("ERROR: could not create avcC record %s\n", name);
+        return;
+    }
+    hdr[0] = 1; // configurationVersion
+    hdr[1] = ggo_sps[1]; // AVCProfileIndication
+    hdr[2] = ggo_sps[2]; // profile_compatibility
+    hdr[3] = ggo_sps[3]; // AVCLevelIndication
+    hdr[4] = 0xfc | 3; // lengthSizeMinusOne = 3
+    hdr[5] = 0xe0 | 1; // numOfSequenceParameterSets
+    fwrite(hdr, 1, 6, fp);
+    fputc((ggo_sps_len >> 8) & 0xff, fp);
+    fputc(ggo_sps_len & 0xff, fp);
+    fwrite(ggo_sps, 1, ggo_sps_len, fp);
+    fputc(1, fp); // numOfPictureParameterSets
+    fputc((ggo_pps_len >> 8) & 0xff, fp);
+    fputc(ggo_pps_len & 0xff, fp);
+    fwrite(ggo_pps, 1, ggo_pps_len, fp);
+    fclose(fp);
 }
 
 void ggo_putbits(int val, int len, const char *desc )
@@ -194,6 +332,7 @@ int ggo_put_ue_len(int val ) {
 
 
 void ggo_put_se(int val, const char *desc ) { ggo_put_ue((val > 0) ? (val * 2 - 1) : (-2 * val), desc ); }
+int ggo_put_se_len(int val) { return(ggo_put_ue_len((val > 0) ? (val * 2 - 1) : (-2 * val))); }
 
 void ggo_put_te(int val, int max, const char *desc ) {
     if (max == 1) {
@@ -218,6 +357,14 @@ void ggo_rbsp_trailing_bits() {
 
 void ggo_put_null(const char* desc) { }
 
+// Level from the frame size (Table A-1 MaxFS), 4.2 up to 1080p
+#define GGO_MAX_FS 139264 // level 6.x, 8192x4320
+int ggo_level_idc()
+{
+    int fs = mb_width * mb_height;
+    return((fs <= 8704) ? 42 : (fs <= 36864) ? 51 : 60);
+}
+
 void ggo_sequence_parameter_set() { 
     // Nal unit 
     ggo_put_start(4);
@@ -236,7 +383,7 @@ void ggo_sequence_parameter_set() {
     ggo_putbits( 0, 1, "constraint_set4_flag /* equal to 0; ignored by decoders */ u(1)");
     ggo_putbits( 0, 1, "constraint_set5_flag /* equal to 0; ignored by decoders */ u(1)");
     ggo_putbits( 0, 2, "reserved_zero_2bits /* equal to 0 */ u(2)");
-    ggo_putbits(42, 8, "level_idc u(8)");
+    ggo_putbits(ggo_level_idc(), 8, "level_idc u(8)");
     ggo_put_ue ( 0,    "seq_parameter_set_id ue(v)");
     ggo_put_ue ( 0,    "log2_max_frame_num_minus4 ue(v)");
     ggo_put_ue ( 0,    "pic_order_cnt_type ue(v)");
@@ -247,9 +394,18 @@ void ggo_sequence_parameter_set() {
     ggo_put_ue ( mb_height- 1,    "pic_height_in_map_units_minus1 ue(v)");
     ggo_putbits( 1, 1, "frame_mbs_only_flag /*equal to 1*/ u(1)");
     ggo_putbits( 0, 1, "direct_8x8_inference_flag u(1)");
-    ggo_putbits( 0, 1, "frame_cropping_flag u(1)");
+    if (mb_width * 16 != pic_width || mb_height * 16 != pic_height) { // 4:2:0 crop units are 2 samples
+        ggo_putbits( 1, 1, "frame_cropping_flag u(1)");
+        ggo_put_ue ( 0, "frame_crop_left_offset ue(v)");
+        ggo_put_ue ( (mb_width * 16 - pic_width) >> 1, "frame_crop_right_offset ue(v)");
+        ggo_put_ue ( 0, "frame_crop_top_offset ue(v)");
+        ggo_put_ue ( (mb_height * 16 - pic_height) >> 1, "frame_crop_bottom_offset ue(v)");
+    }
+    else
+        ggo_putbits( 0, 1, "frame_cropping_flag u(1)");
     ggo_putbits( 0, 1, "vui_parameters_present_flag u(1)");
     ggo_rbsp_trailing_bits();
+    ggo_nal_end(0);
     ggo_put_null("}");
 }
 
@@ -279,6 +435,7 @@ void ggo_picture_parameter_set() {
     ggo_putbits( 0, 1, "constrained_intra_pred_flag u(1)");
     ggo_putbits( 0, 1, "redundant_pic_cnt_present_flag /* equal to zero*/ u(1)");
     ggo_rbsp_trailing_bits();
+    ggo_nal_end(0);
     ggo_put_null("}");
 }
 
@@ -332,18 +489,19 @@ void ggo_long_term_grey_idc_slice( int IdrPicFlag ) {
             // write recon
             for (int py = 0; py < 16; py++)
                 for (int px = 0; px < 16; px++) {
-                    ggo_recon_y[(mby * 16 + py) * mb_width * 16 + mbx * 16 + px] = 128;
+                    ggo_recon_y[(mby * 16 + py) * ggo_stride_y + mbx * 16 + px] = 128;
                 }
             for (int py = 0; py < 8; py++)
                 for (int px = 0; px < 8; px++) {
-                    ggo_recon_cb[(mby * 8 + py) * mb_width * 8 + mbx * 8 + px] = 128;
-                    ggo_recon_cr[(mby * 8 + py) * mb_width * 8 + mbx * 8 + px] = 128;
+                    ggo_recon_cb[(mby * 8 + py) * ggo_stride_c + mbx * 8 + px] = 128;
+                    ggo_recon_cr[(mby * 8 + py) * ggo_stride_c + mbx * 8 + px] = 128;
                 }
         }
     ggo_put_null("}");
 
     // stop slice
     ggo_rbsp_trailing_bits();
+    ggo_nal_end(1);
     ggo_put_null("}");
     }
 
@@ -387,6 +545,7 @@ void ggo_pskip_slice() {
 
     // stop slice
     ggo_rbsp_trailing_bits();
+    ggo_nal_end(1);
     ggo_put_null("}");
 }
 
@@ -443,6 +602,7 @@ void ggo_ref1_copy_slice() {
 
     // stop slice
     ggo_rbsp_trailing_bits();
+    ggo_nal_end(1);
     ggo_put_null("}");
 }
 
@@ -483,30 +643,29 @@ void ggo_pcm_slice()
             ggo_put_null("macroblock_layer() {");
             ggo_put_ue(25, "mb_type ue(v)");
             ggo_align();
-            for (int py = 0; py < 16; py++)
-                for (int px = 0; px < 16; px++)
-                    ggo_pcm_putbyte(ggi_y[xx * 16 + px + (yy * 16 + py) * mb_width*16]);
-            for (int py = 0; py < 8; py++)
-                for (int px = 0; px < 8; px++)
-                    ggo_pcm_putbyte(ggi_cb[xx * 8 + px + (yy * 8 + py) * mb_width*8 ]);
-            for (int py = 0; py < 8; py++)
-                for (int px = 0; px < 8; px++)
-                    ggo_pcm_putbyte(ggi_cr[xx * 8 + px + (yy * 8 + py) * mb_width*8 ]);
+            gg_input_load_mb(&ggi_frame, xx, yy, ggi_mb_y, ggi_mb_cb, ggi_mb_cr);
+            for (int ii = 0; ii < 256; ii++)
+                ggo_pcm_putbyte(ggi_mb_y[ii]);
+            for (int ii = 0; ii < 64; ii++)
+                ggo_pcm_putbyte(ggi_mb_cb[ii]);
+            for (int ii = 0; ii < 64; ii++)
+                ggo_pcm_putbyte(ggi_mb_cr[ii]);
             ggo_put_null("}");
             // Write Recon image
             for (int py = 0; py < 16; py++)
                 for (int px = 0; px < 16; px++)
-                    ggo_recon_y[xx * 16 + px + (yy * 16 + py) * mb_width * 16] = ggi_y[xx * 16 + px + (yy * 16 + py) * mb_width * 16];
+                    ggo_recon_y[xx * 16 + px + (yy * 16 + py) * ggo_stride_y] = ggi_mb_y[py * 16 + px];
             for (int py = 0; py < 8; py++)
                 for (int px = 0; px < 8; px++) {
-                    ggo_recon_cb[xx * 8 + px + (yy * 8 + py) * mb_width * 8] = ggi_cb[xx * 8 + px + (yy * 8 + py) * mb_width * 8];
-                    ggo_recon_cr[xx * 8 + px + (yy * 8 + py) * mb_width * 8] = ggi_cr[xx * 8 + px + (yy * 8 + py) * mb_width * 8];
+                    ggo_recon_cb[xx * 8 + px + (yy * 8 + py) * ggo_stride_c] = ggi_mb_cb[py * 8 + px];
+                    ggo_recon_cr[xx * 8 + px + (yy * 8 + py) * ggo_stride_c] = ggi_mb_cr[py * 8 + px];
                 }
         }
     ggo_put_null("}");
 
     // stop slice
     ggo_rbsp_trailing_bits();
+    ggo_nal_end(1);
     ggo_put_null("}");
 
 }
@@ -529,6 +688,72 @@ void ggo_put_bitbuffer(bitbuffer* bits, const char *desc)
 /////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// Emulation prevention bytes allowed for the next macroblock, not known until written. A typical margin, not the
+// worst case (one per two bytes of a 3088 bit macroblock), so a slice can rarely end a few bytes over mtu_slice_bytes
+#define GGO_EMU_RESERVE 4
+
+// Write P slice NAL header and slice header, up to the start of slice_data()
+void ggo_inter_slice_header(int first_mb, int qp)
+{
+    // Nal unit 
+    ggo_put_start(3);
+    ggo_put_null("nal_unit( NumBytesInNALunit ) {  ");
+    ggo_putbits(0, 1, "forbidden_zero_bit f(1)  ");
+    ggo_putbits(1, 2, "nal_ref_idc u(2)         ");
+    ggo_putbits(1, 5, "nal_unit_type u(5) 1=non-idr");
+    ggo_put_null("}");
+    // RBSP
+    ggo_put_null("slice_header() {");
+    ggo_put_ue(first_mb, "first_mb_in_slice ue(v)     ");
+    ggo_put_ue(0, "slice_type ue(v) 0=P Slice  ");
+    ggo_put_ue(0, "pic_parameter_set_id ue(v)  ");
+    ggo_putbits(ggo_frame, 4, "frame_num u(v)          "); // same for all slices of the picture
+    ggo_putbits(ggo_frame, 4, "pic_order_cnt_lsb u(v)  ");
+    ggo_putbits(0, 1, "num_ref_idx_active_override_flag u(1)");
+
+    ggo_put_null("ref_pic_list_modification() {");
+    ggo_putbits(0, 1, "ref_pic_list_modification_flag_l0 u(1)");
+    ggo_put_null("}");
+
+    ggo_put_null("dec_ref_pic_marking() {");
+    ggo_putbits(0, 1, "adaptive_ref_pic_marking_mode_flag u(1)");
+    ggo_put_null("}");
+
+    ggo_put_se(qp - 26, "slice_qp_delta se(v)        "); // assume pps default is 26. qp in {0,51}
+    ggo_put_ue(pintra_disable_deblocking_filter_idc, "disable_deblocking_filter_idc ue(v)");
+    if (pintra_disable_deblocking_filter_idc != 1) {
+        ggo_put_se(0, "slice_alpha_c0_offset_div2 se(v)");
+        ggo_put_se(0, "slice_beta_offset_div2 se(v)");
+    }
+    ggo_put_null("}");
+
+    // Macroblocks
+    ggo_put_null("slice_data() {");
+}
+
+// End slice_data() with the pending skip run and close the NAL
+void ggo_inter_slice_close(int skip_run, int au_end)
+{
+    if (skip_run) { // final skip run for slice
+        ggo_put_ue(skip_run, "mb_skip_run ue(v)");
+    }
+    ggo_put_null("}");
+    // stop slice
+    ggo_rbsp_trailing_bits();
+    ggo_nal_end(au_end);
+    ggo_put_null("}");
+}
+
+// Estimated NAL bytes (excluding start code) if the next macroblock is coded and the slice then closed, best effort
+// mb_bits is the macroblock_layer() length, or 0 if the macroblock is skipped
+int ggo_slice_bytes_est(int skip_run, int mb_bits)
+{
+    int bits = ggo_nal_len * 8 + ((ggo_bitpos) ? 8 - ggo_bitpos : 0);
+    bits += (mb_bits) ? ggo_put_ue_len(skip_run) + mb_bits : ggo_put_ue_len(skip_run + 1);
+    bits += 1; // rbsp_stop_one_bit
+    return((bits + 7) / 8 + GGO_EMU_RESERVE);
+}
+
 // Encode a frame using fixed 128 ref frame, mvd 0,0. (e.g. a P-intra block)
 // skips are enabled if ref =0. For ref = 1, we could modify the ref pic list, but we want to test this mode
 void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice_flag ) {
@@ -545,67 +770,35 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
     int orig_dc_cr[16], recon_dc_cr[16], ref_dc_cr[16];
     int dc_hold[3][16];
     int skip_run = 0;
+    int slice_start = 0; // start a new slice at the next macroblock
+    int slice_mb = 0; // macroblocks coded in current slice
     int ofs = 0;
     int dz = 0;
-    char abvnc_y[PIC_WIDTH >> 2], abvnc_cb[PIC_WIDTH >> 3], abvnc_cr[PIC_WIDTH >> 3];
+    char* abvnc_y = ggo_abvnc;
+    char* abvnc_cb = ggo_abvnc + mb_width * 4;
+    char* abvnc_cr = ggo_abvnc + mb_width * 6;
     char lefnc_y[4], lefnc_cb[2], lefnc_cr[2];
     int num_coeff_y[16], num_coeff_cb[4], num_coeff_cr[4];
+    unsigned char pred_y[256], pred_cb[64], pred_cr[64]; // motion compensated prediction
+    int mvx, mvy, mvpx, mvpy, skipx, skipy;
 
     // Init Deblock;
-    gg_deblock_init( &dbp, pintra_disable_deblocking_filter_idc, filterOffsetA, filterOffsetB, mb_width, mb_height ); // allocate and deblock for start of single slice frame
+    gg_deblock_init( &dbp, pintra_disable_deblocking_filter_idc, filterOffsetA, filterOffsetB, mb_width, mb_height, ggo_stride_y, ggo_stride_c ); // allocate and deblock for start of single slice frame
 
  
     // Process frame of macroblocks
     for (int yy = 0; yy < mb_height; yy++) { // For each macroblock row.
+        ggi_wait_row(yy); // input row arrived
+        for (int ii = 0; ii < 2; ii++) { // ref rows this row can predict from are filtered, and interpolated (needs 3 more lines)
+            int rows = MIN(mb_height, yy + 1 + ((ggo_me.range + 15) >> 4));
+            gg_deblock_wait_rows(&dbp, ggo_ref_y[ii], rows + ggo_me.subpel);
+            if (ggo_me.subpel)
+                gg_me_hpel_rows(&ggo_me, ggo_refpic.ref[ii], ggo_stride_y, rows);
+            if (ggo_me.pyramid && ii == 0) // only ref 0 is searched
+                gg_me_lowres_rows(&ggo_me, ggo_refpic.ref[0], ggo_stride_y, rows);
+        }
         if (yy == 0 || row_slice_flag) {
-
-            // Nal unit 
-            ggo_put_start(3);
-            ggo_put_null("nal_unit( NumBytesInNALunit ) {  ");
-            ggo_putbits(0, 1, "forbidden_zero_bit f(1)  ");
-            ggo_putbits(1, 2, "nal_ref_idc u(2)         ");
-            ggo_putbits(1, 5, "nal_unit_type u(5) 1=non-idr");
-            ggo_put_null("}");
-            // RBSP
-            ggo_put_null("slice_header() {");
-            ggo_put_ue(yy * mb_width, "first_mb_in_slice ue(v)     ");
-            ggo_put_ue(0, "slice_type ue(v) 0=P Slice  ");
-            ggo_put_ue(0, "pic_parameter_set_id ue(v)  ");
-            ggo_putbits(ggo_frame, 4, "frame_num u(v)          ");
-            ggo_putbits(ggo_frame++, 4, "pic_order_cnt_lsb u(v)  ");
-            ggo_putbits(0, 1, "num_ref_idx_active_override_flag u(1)");
-
-            ggo_put_null("ref_pic_list_modification() {");
-            ggo_putbits(0, 1, "ref_pic_list_modification_flag_l0 u(1)");
-            ggo_put_null("}");
-
-            ggo_put_null("dec_ref_pic_marking() {");
-            ggo_putbits(0, 1, "adaptive_ref_pic_marking_mode_flag u(1)");
-            ggo_put_null("}");
-
-            ggo_put_se(qp - 26, "slice_qp_delta se(v)        "); // assume pps default is 26. qp in {0,51}
-            ggo_put_ue(pintra_disable_deblocking_filter_idc, "disable_deblocking_filter_idc ue(v)");
-            if (pintra_disable_deblocking_filter_idc != 1) {
-                ggo_put_se(0, "slice_alpha_c0_offset_div2 se(v)");
-                ggo_put_se(0, "slice_beta_offset_div2 se(v)");
-            }
-            ggo_put_null("}");
-
-            // Macroblocks
-            ggo_put_null("slice_data() {");
-
-            // Clear abvnc
-            for (int ii = 0; ii < (PIC_WIDTH >> 2); ii++) {
-                abvnc_y[ii] = -1;
-            }
-            for (int ii = 0; ii < (PIC_WIDTH >> 3); ii++) {
-                abvnc_cb[ii] = -1;
-                abvnc_cr[ii] = -1;
-            }
-
-            skip_run = 0;
-
-            gg_deblock_init_row(&dbp); // Marks above as oop
+            slice_start = 1;
         }
 
         // Clear lefnc 
@@ -625,13 +818,57 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
             if (intra_col_width)
                 refidx = (xx >= ggo_intra_col && xx < ggo_intra_col + intra_col_width) ? 1 : 0;
 
-            //Load Luma orig and ref[refidx]
+            if (slice_start) {
+                slice_start = 0;
+                slice_mb = 0;
+                ggo_inter_slice_header(yy * mb_width + xx, qp);
+
+                // Clear abvnc, lefnc, neighbours outside the slice are not available
+                for (int ii = 0; ii < mb_width * 4; ii++) {
+                    abvnc_y[ii] = -1;
+                }
+                for (int ii = 0; ii < mb_width * 2; ii++) {
+                    abvnc_cb[ii] = -1;
+                    abvnc_cr[ii] = -1;
+                }
+                for (int ii = 0; ii < 4; ii++) {
+                    lefnc_y[ii] = -1;
+                }
+                for (int ii = 0; ii < 2; ii++) {
+                    lefnc_cb[ii] = -1;
+                    lefnc_cr[ii] = -1;
+                }
+
+                skip_run = 0;
+
+                gg_deblock_init_slice(&dbp, yy * mb_width + xx);
+                gg_me_init_slice(&ggo_me, yy * mb_width + xx);
+            }
+
+            //Load Luma orig and ref[refidx], orig gathered once per mb from the input planes
+            gg_input_load_mb(&ggi_frame, xx, yy, ggi_mb_y, ggi_mb_cb, ggi_mb_cr);
+            if (ggo_me.pyramid) // source pyramid, built as the macroblocks are loaded
+                gg_me_lowres_mb(&ggo_me, xx, yy, ggi_mb_y);
+
+            // Motion, ref 0 is searched. The long term ref is flat grey, it takes the predicted mv (no mvd bits) when that stays inside
+            gg_me_pred_mv(&ggo_me, xx, yy, refidx, &mvpx, &mvpy);
+            gg_me_skip_mv(&ggo_me, xx, yy, &skipx, &skipy);
+            mvx = mvy = 0;
+            if (refidx == 0 && ggo_me.range)
+                gg_me_search(&ggo_me, xx, yy, ggi_mb_y, ggo_refpic.ref[0], ggo_stride_y, qp, mvpx, mvpy, skipx, skipy, &mvx, &mvy);
+            else if (refidx == 1 && gg_me_mv_ok(&ggo_me, xx, yy, mvpx, mvpy)) {
+                mvx = mvpx;
+                mvy = mvpy;
+            }
+            gg_me_pred_luma(ggo_refpic.ref[refidx], ggo_stride_y, xx, yy, mvx, mvy, pred_y);
+            gg_me_pred_chroma((const unsigned char*)ggo_ref_cb[refidx], ggo_stride_c, xx, yy, mvx, mvy, pred_cb);
+            gg_me_pred_chroma((const unsigned char*)ggo_ref_cr[refidx], ggo_stride_c, xx, yy, mvx, mvy, pred_cr);
             for (int by = 0; by < 4; by++)
                 for (int bx = 0; bx < 4; bx++)
                     for (int py = 0; py < 4; py++)
                         for (int px = 0; px < 4; px++) {
-                            orig_y[by * 4 + bx][py * 4 + px] = 0xff & ggi_y[xx * 16 + bx * 4 + px + (yy * 16 + by * 4 + py) * mb_width * 16];
-                            ref_y[by * 4 + bx][py * 4 + px] = 0xff & ggo_ref_y[refidx][xx * 16 + bx * 4 + px + (yy * 16 + by * 4 + py) * mb_width * 16];
+                            orig_y[by * 4 + bx][py * 4 + px] = ggi_mb_y[(by * 4 + py) * 16 + bx * 4 + px];
+                            ref_y[by * 4 + bx][py * 4 + px] = pred_y[(by * 4 + py) * 16 + bx * 4 + px];
                         }
 
             // Clear Chroma DC (as will be sparely populated accumulations)
@@ -648,10 +885,10 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
                 for (int bx = 0; bx < 2; bx++)
                     for (int py = 0; py < 4; py++)
                         for (int px = 0; px < 4; px++) {
-                            orig_dc_cb[by * 8 + bx * 2] += (orig_cb[by * 2 + bx][py * 4 + px] = 0xff & ggi_cb[xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * mb_width * 8]);
-                            orig_dc_cr[by * 8 + bx * 2] += (orig_cr[by * 2 + bx][py * 4 + px] = 0xff & ggi_cr[xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * mb_width * 8]);
-                            ref_dc_cb[by * 8 + bx * 2] += (ref_cb[by * 2 + bx][py * 4 + px] = 0xff & ggo_ref_cb[refidx][xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * mb_width * 8]);
-                            ref_dc_cr[by * 8 + bx * 2] += (ref_cr[by * 2 + bx][py * 4 + px] = 0xff & ggo_ref_cr[refidx][xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * mb_width * 8]);
+                            orig_dc_cb[by * 8 + bx * 2] += (orig_cb[by * 2 + bx][py * 4 + px] = ggi_mb_cb[(by * 4 + py) * 8 + bx * 4 + px]);
+                            orig_dc_cr[by * 8 + bx * 2] += (orig_cr[by * 2 + bx][py * 4 + px] = ggi_mb_cr[(by * 4 + py) * 8 + bx * 4 + px]);
+                            ref_dc_cb[by * 8 + bx * 2] += (ref_cb[by * 2 + bx][py * 4 + px] = pred_cb[(by * 4 + py) * 8 + bx * 4 + px]);
+                            ref_dc_cr[by * 8 + bx * 2] += (ref_cr[by * 2 + bx][py * 4 + px] = pred_cr[(by * 4 + py) * 8 + bx * 4 + px]);
                         }
 
             if (yy == 0 && xx == 0) {
@@ -710,21 +947,32 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
             cbp = (num_coeff) ? 0x20 | (cbp & 0xf) : cbp;
             macroblock_layer_length += (num_coeff) ? (bitcount[0] + bitcount[1] + bitcount[2] + bitcount[3] +
                 bitcount[4] + bitcount[5] + bitcount[6] + bitcount[7]) : 0;
-            macroblock_layer_length += 5; // adjust length +5 for: mbtype, refidx, mvdxm mvdy, qpd
+            macroblock_layer_length += 3 + ggo_put_se_len(mvx - mvpx) + ggo_put_se_len(mvy - mvpy); // adjust length for: mbtype, refidx, qpd, mvdx, mvdy
             macroblock_layer_length += ggo_put_ue_len(ggo_inter_me[cbp]); // add CBP length
 
+            // MTU slices: end the slice before this macroblock would push the NAL past mtu_slice_bytes,
+            // and re-code the macroblock as the first of a new slice (with reset nC contexts and skip run)
+            if (mtu_slice_bytes && slice_mb &&
+                ggo_slice_bytes_est(skip_run, (refidx == 0 && cbp == 0 && mvx == skipx && mvy == skipy) ? 0 : MIN(macroblock_layer_length, 3088)) > mtu_slice_bytes) {
+                ggo_inter_slice_close(skip_run, 0);
+                slice_start = 1;
+                xx--;
+                continue;
+            }
+            slice_mb++;
+
             // Now and only now, we can nominally code the macroblock, skips not possible when ref1 is used
-            if (refidx == 0 && cbp == 0) { // skip this MB if ref=0 and cbp=0
+            if (refidx == 0 && cbp == 0 && mvx == skipx && mvy == skipy) { // skip this MB if ref=0, cbp=0 and the mv is the skip mv
                 mb_type = GG_MBTYPE_SKIP;
                 skip_run++;
                 // Write Recon
                 for (int py = 0; py < 16; py++)
                     for (int px = 0; px < 16; px++)
-                        ggo_recon_y[xx * 16 + px + (yy * 16 + py) * mb_width * 16] = 0xff & ggo_ref_y[refidx][xx * 16 + px + (yy * 16 + py) * mb_width * 16];
+                        ggo_recon_y[xx * 16 + px + (yy * 16 + py) * ggo_stride_y] = pred_y[py * 16 + px];
                 for (int py = 0; py < 8; py++)
                     for (int px = 0; px < 8; px++) {
-                        ggo_recon_cb[xx * 8 + px + (yy * 8 + py) * mb_width * 8] = 0xff & ggo_ref_cb[refidx][xx * 8 + px + (yy * 8 + py) * mb_width * 8];
-                        ggo_recon_cr[xx * 8 + px + (yy * 8 + py) * mb_width * 8] = 0xff & ggo_ref_cr[refidx][xx * 8 + px + (yy * 8 + py) * mb_width * 8];
+                        ggo_recon_cb[xx * 8 + px + (yy * 8 + py) * ggo_stride_c] = pred_cb[py * 8 + px];
+                        ggo_recon_cr[xx * 8 + px + (yy * 8 + py) * ggo_stride_c] = pred_cr[py * 8 + px];
                     }
                 // Force nC to zero, in case this skip decision was forced
                 lefnc_y[0] = 0;          lefnc_cb[0] = 0;
@@ -739,29 +987,27 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
             else if (macroblock_layer_length > 3088) { // A.3.1.n, max MB length is 3200, however PCM is pel(3072)+mbtype(9)+max align(7)=3088 
 //          else if ( xx % 10 == 1 && yy % 10 == 1) { // just force sparse pcm to test 
                 mb_type = GG_MBTYPE_IPCM;
+                mvx = mvy = 0;
                 ggo_put_ue(skip_run, "mb_skip_run ue(v)");
                 skip_run = 0;
                 ggo_put_null("macroblock_layer() {           ");
                 ggo_put_ue(30, "mb_type ue(v) PCM is 30 in Pframes");
                 ggo_align();
-                for (int py = 0; py < 16; py++)
-                    for (int px = 0; px < 16; px++)
-                        ggo_pcm_putbyte(ggi_y[xx * 16 + px + (yy * 16 + py) * mb_width * 16]);
-                for (int py = 0; py < 8; py++)
-                    for (int px = 0; px < 8; px++)
-                        ggo_pcm_putbyte(ggi_cb[xx * 8 + px + (yy * 8 + py) * mb_width * 8]);
-                for (int py = 0; py < 8; py++)
-                    for (int px = 0; px < 8; px++)
-                        ggo_pcm_putbyte(ggi_cr[xx * 8 + px + (yy * 8 + py) * mb_width * 8]);
+                for (int ii = 0; ii < 256; ii++)
+                    ggo_pcm_putbyte(ggi_mb_y[ii]);
+                for (int ii = 0; ii < 64; ii++)
+                    ggo_pcm_putbyte(ggi_mb_cb[ii]);
+                for (int ii = 0; ii < 64; ii++)
+                    ggo_pcm_putbyte(ggi_mb_cr[ii]);
                 ggo_put_null("}");
                 // Write Recon
                 for (int py = 0; py < 16; py++)
                     for (int px = 0; px < 16; px++)
-                        ggo_recon_y[xx * 16 + px + (yy * 16 + py) * mb_width * 16] = ggi_y[xx * 16 + px + (yy * 16 + py) * mb_width * 16];
+                        ggo_recon_y[xx * 16 + px + (yy * 16 + py) * ggo_stride_y] = ggi_mb_y[py * 16 + px];
                 for (int py = 0; py < 8; py++)
                     for (int px = 0; px < 8; px++) {
-                        ggo_recon_cb[xx * 8 + px + (yy * 8 + py) * mb_width * 8] = ggi_cb[xx * 8 + px + (yy * 8 + py) * mb_width * 8];
-                        ggo_recon_cr[xx * 8 + px + (yy * 8 + py) * mb_width * 8] = ggi_cr[xx * 8 + px + (yy * 8 + py) * mb_width * 8];
+                        ggo_recon_cb[xx * 8 + px + (yy * 8 + py) * ggo_stride_c] = ggi_mb_cb[py * 8 + px];
+                        ggo_recon_cr[xx * 8 + px + (yy * 8 + py) * ggo_stride_c] = ggi_mb_cr[py * 8 + px];
                     }
                 // Update left, above nC's to 16 for PCM
                 lefnc_y[0] = 16; lefnc_cb[0] = 16;
@@ -781,8 +1027,8 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
                 ggo_put_ue(0, "mb_type ue(v)  P L0 16x16 = 0");
                 ggo_put_null("mb_pred( mb_type ) {");
                 ggo_put_te(refidx, 1, "ref_idx_l0[mbPartIdx] te(v)");
-                ggo_put_se(0, "mvd_l0[ 0 ][ 0 ][ 0 ] se(v)");
-                ggo_put_se(0, "mvd_l0[ 0 ][ 0 ][ 1 ] se(v)");
+                ggo_put_se(mvx - mvpx, "mvd_l0[ 0 ][ 0 ][ 0 ] se(v)");
+                ggo_put_se(mvy - mvpy, "mvd_l0[ 0 ][ 0 ][ 1 ] se(v)");
                 ggo_put_null("}");
                 ggo_put_me(cbp, 0, "coded_block_pattern me(v)");
                 if (cbp) {
@@ -834,35 +1080,34 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
                     for (int bx = 0; bx < 4; bx++)
                         for (int py = 0; py < 4; py++)
                             for (int px = 0; px < 4; px++) {
-                                ggo_recon_y[xx * 16 + bx * 4 + px + (yy * 16 + by * 4 + py) * mb_width * 16] = recon_y[by * 4 + bx][py * 4 + px];
+                                ggo_recon_y[xx * 16 + bx * 4 + px + (yy * 16 + by * 4 + py) * ggo_stride_y] = recon_y[by * 4 + bx][py * 4 + px];
 
                             }
                 for (int by = 0; by < 2; by++)
                     for (int bx = 0; bx < 2; bx++)
                         for (int py = 0; py < 4; py++)
                             for (int px = 0; px < 4; px++) {
-                                ggo_recon_cb[xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * mb_width * 8] = recon_cb[by * 2 + bx][py * 4 + px];
-                                ggo_recon_cr[xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * mb_width * 8] = recon_cr[by * 2 + bx][py * 4 + px];
+                                ggo_recon_cb[xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * ggo_stride_c] = recon_cb[by * 2 + bx][py * 4 + px];
+                                ggo_recon_cr[xx * 8 + bx * 4 + px + (yy * 8 + by * 4 + py) * ggo_stride_c] = recon_cr[by * 2 + bx][py * 4 + px];
                             }
             }
 
+            gg_me_set_mb(&ggo_me, xx, yy, (mb_type == GG_MBTYPE_IPCM) ? -1 : refidx, mvx, mvy);
+
             // Deblock Macroblock after skip/pcm/inter decision finalized
             if (pintra_disable_deblocking_filter_idc != 1) {
-                gg_deblock_mb(&dbp, xx, yy, ggo_recon_y, ggo_recon_cb, ggo_recon_cr, num_coeff_y, num_coeff_cb, num_coeff_cr, qp, refidx, mb_type);
+                gg_deblock_mb(&dbp, xx, yy, ggo_recon_y, ggo_recon_cb, ggo_recon_cr, num_coeff_y, num_coeff_cb, num_coeff_cr, qp, refidx, mvx, mvy, mb_type);
             }
         }
+        if (psnr_flag && yy == mb_height - 1)
+            psnr_frame(); // before the input picture is released
+        ggi_row_done(yy); // input row consumed
 
         if (yy == mb_height - 1 || row_slice_flag) {
-            // No final skip_run as ref1 is used
-            if (skip_run) { // final skip run for frame
-                ggo_put_ue(skip_run, "mb_skip_run ue(v)");
-            }
-            ggo_put_null("}");
-            // stop slice
-            ggo_rbsp_trailing_bits();
-            ggo_put_null("}");
+            ggo_inter_slice_close(skip_run, yy == mb_height - 1);
         }
     }
+    ggo_frame++;
 
     if (intra_col_width) {
         ggo_intra_col = (ggo_intra_col + intra_col_width);
@@ -877,98 +1122,211 @@ void ggo_inter_0_0_slice( int qp, int refidx, int intra_col_width, int row_slice
 /////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////
 
-void ggi_init(const char* filename)
+// Capture thread for raster mode, pushes each source picture one macroblock row at a time
+gg_thread_ret GG_THREAD_CALL ggi_capture_thread(void* arg)
 {
-    ggi_fp = fopen(filename, "rb");
+    YuvFrame frame;
+    while (!gg_input_read(&ggi_src, &frame)) {
+        for (int yy = 0; yy < ggi_src.height; yy += 16) {
+            if (gg_input_push_rows(&ggi, frame.y + yy * frame.stride_y, frame.cb + (yy >> 1) * frame.stride_c, frame.cr + (yy >> 1) * frame.stride_c,
+                frame.stride_y, frame.stride_c, frame.chroma_step, 16))
+                return(0);
+        }
+    }
+    gg_input_push_end(&ggi);
+    return(0);
 }
 
-void ggi_read_frame()
+int ggi_init(const char* filename, int stride)
 {
-    char* p;
-    p = ggi_y;
-    for (int ii = 0; ii < (mb_width * mb_height * 256); ii++)
-        *p++ = fgetc(ggi_fp);
+    if (!raster_flag)
+        return(gg_input_open(&ggi, filename, pic_width, pic_height, stride, (input_nv12_flag) ? GG_YUV_NV12 : GG_YUV_I420));
+    if (gg_input_open(&ggi_src, filename, pic_width, pic_height, stride, (input_nv12_flag) ? GG_YUV_NV12 : GG_YUV_I420))
+        return(-1);
+    if (gg_input_open_raster(&ggi, ggi_src.width, ggi_src.height))
+        return(-1);
+    ggi.fps_num = ggi_src.fps_num;
+    ggi.fps_den = ggi_src.fps_den;
+    if (gg_thread_create(&ggi_capture, ggi_capture_thread, NULL)) {
+        printf("ERROR: could not start capture thread\n");
+        return(-1);
+    }
+    return(0);
+}
 
-    p = ggi_cb;
-    for (int ii = 0; ii < (mb_width * mb_height * 64); ii++)
-        *p++ = fgetc(ggi_fp);
+// Next input picture, zero copy: ggi_frame points into the mapped file or a filled stream buffer
+int ggi_read_frame()
+{
+    return(gg_input_read(&ggi, &ggi_frame));
+}
 
-    p = ggi_cr;
-    for (int ii = 0; ii < (mb_width * mb_height * 64); ii++)
-        *p++ = fgetc(ggi_fp);
+// Block until the input for macroblock row mb_row is in (raster input)
+void ggi_wait_row(int mb_row)
+{
+    gg_input_wait_row(&ggi, mb_row);
+}
 
+// Input rows no longer referenced, lets a shared or pooled frame be recycled early
+void ggi_row_done(int mb_row)
+{
+    gg_input_row_done(&ggi, mb_row);
+}
 
-    //fgets(ggi_y,  mb_height * mb_width * 256, ggi_fp);
-    //fgets(ggi_cb, mb_height * mb_width * 64 , ggi_fp);
-    //fgets(ggi_cr, mb_height * mb_width * 64 , ggi_fp);
+void ggi_close()
+{
+    if (raster_flag) {
+        gg_input_stop(&ggi);
+        gg_thread_join(ggi_capture);
+        gg_input_close(&ggi_src);
+    }
+    gg_input_close(&ggi);
 }
 
 void recon_init(const char* name)
 {
-    ggo_recon_fp = fopen(name, "wb");
+    if (recon_flag)
+        gg_yuvout_open(&ggo_recon_out, name, &ggo_refpic, recon_async_flag);
 }
 
 void recon_close()
 {
-    fclose(ggo_recon_fp);
+    gg_yuvout_close(&ggo_recon_out);
 }
 
+// Output the recon picture, queued to the writer thread before it is swapped into a ref
 void recon_write_yuv()
 {
-    char* p;
-    p = ggo_recon_y;
-    for (int ii = 0; ii < (mb_width * mb_height * 256); ii++)
-        fputc( *p++, ggo_recon_fp);
+    if (recon_flag) // the writer reads the whole picture
+        gg_deblock_wait_rows(&dbp, ggo_recon_y, mb_height);
+    gg_yuvout_put(&ggo_recon_out, ggo_refpic.recon);
+}
 
-    p = ggo_recon_cb;
-    for (int ii = 0; ii < (mb_width * mb_height * 64); ii++)
-        fputc(*p++, ggo_recon_fp);
+// Recon against the input picture, per plane PSNR over the cropped picture
+void psnr_frame()
+{
+    long long ssd[3], num[3];
+    double psnr[3];
+
+    gg_deblock_wait_rows(&dbp, ggo_recon_y, mb_height);
+    num[0] = (long long)pic_width * pic_height;
+    num[1] = num[2] = num[0] >> 2;
+    ssd[0] = gg_dist_ssd_plane((const unsigned char*)ggi_frame.y, ggi_frame.stride_y, 1, (const unsigned char*)ggo_recon_y, ggo_stride_y, pic_width, pic_height);
+    ssd[1] = gg_dist_ssd_plane((const unsigned char*)ggi_frame.cb, ggi_frame.stride_c, ggi_frame.chroma_step, (const unsigned char*)ggo_recon_cb, ggo_stride_c, pic_width >> 1, pic_height >> 1);
+    ssd[2] = gg_dist_ssd_plane((const unsigned char*)ggi_frame.cr, ggi_frame.stride_c, ggi_frame.chroma_step, (const unsigned char*)ggo_recon_cr, ggo_stride_c, pic_width >> 1, pic_height >> 1);
+    for (int ii = 0; ii < 3; ii++) {
+        psnr[ii] = gg_dist_psnr(ssd[ii], num[ii]);
+        ggo_psnr_ssd[ii] += ssd[ii];
+        ggo_psnr_sum[ii] += psnr[ii];
+    }
+    printf("\nFrame %d PSNR Y %.2f Cb %.2f Cr %.2f\n", ggo_psnr_frames++, psnr[0], psnr[1], psnr[2]);
+}
 
-    p = ggo_recon_cr;
-    for (int ii = 0; ii < (mb_width * mb_height * 64); ii++)
-        fputc(*p++, ggo_recon_fp);
+void psnr_report()
+{
+    long long num = (long long)pic_width * pic_height * ggo_psnr_frames;
+    if (!ggo_psnr_frames)
+        return;
+    printf("PSNR: %d frames, average Y %.2f Cb %.2f Cr %.2f, global Y %.2f Cb %.2f Cr %.2f\n", ggo_psnr_frames,
+        ggo_psnr_sum[0] / ggo_psnr_frames, ggo_psnr_sum[1] / ggo_psnr_frames, ggo_psnr_sum[2] / ggo_psnr_frames,
+        gg_dist_psnr(ggo_psnr_ssd[0], num), gg_dist_psnr(ggo_psnr_ssd[1], num >> 2), gg_dist_psnr(ggo_psnr_ssd[2], num >> 2));
 }
 
-void recon_copy_to_ref(int refidx)
+// Point the recon and ref planes at the current manager pictures
+void refpic_bind()
 {
-    char* recon, *ref;
+    ggo_recon_y = ggo_refpic.recon->y;
+    ggo_recon_cb = ggo_refpic.recon->cb;
+    ggo_recon_cr = ggo_refpic.recon->cr;
+    ggo_stride_y = ggo_refpic.stride_y;
+    ggo_stride_c = ggo_refpic.stride_c;
+    for (int ii = 0; ii < 2; ii++) {
+        ggo_ref_y[ii] = (ggo_refpic.ref[ii]) ? ggo_refpic.ref[ii]->y : NULL;
+        ggo_ref_cb[ii] = (ggo_refpic.ref[ii]) ? ggo_refpic.ref[ii]->cb : NULL;
+        ggo_ref_cr[ii] = (ggo_refpic.ref[ii]) ? ggo_refpic.ref[ii]->cr : NULL;
+    }
+}
 
-    recon = ggo_recon_y;
-    ref = ggo_ref_y[refidx];
-    for (int ii = 0; ii < (mb_width * mb_height * 256); ii++)
-        *ref++ = *recon++;
+int refpic_init()
+{
+    if (gg_refpic_init(&ggo_refpic, pic_width, pic_height, &ggo_pool, (me_range) ? ((me_subpel) ? GG_REFPIC_HPEL : 0) | ((me_pyramid) ? GG_REFPIC_LOWRES : 0) : 0)) // recon output is cropped to the picture
+        return(-1);
+    refpic_bind();
+    return(0);
+}
 
-    recon = ggo_recon_cb;
-    ref = ggo_ref_cb[refidx];
-    for (int ii = 0; ii < (mb_width * mb_height * 64); ii++)
-        *ref++ = *recon++;
+// Recon becomes reference refidx by pointer swap, coding continues into a free buffer
+void recon_to_ref(int refidx)
+{
+    gg_refpic_recon_to_ref(&ggo_refpic, refidx);
+    refpic_bind();
+}
 
-    recon = ggo_recon_cr;
-    ref = ggo_ref_cr[refidx];
-    for (int ii = 0; ii < (mb_width * mb_height * 64); ii++)
-        *ref++ = *recon++;
+// Reference refidx shares the picture of src_idx (refcounted, no copy)
+void ref_share(int refidx, int src_idx)
+{
+    gg_refpic_set_ref(&ggo_refpic, refidx, ggo_refpic.ref[src_idx]);
+    refpic_bind();
 }
 
-int main( int argc, int **argv )
+int main( int argc, char **argv )
 {
     int qp = 40; // 29;
-    test_run_before();
+    const char* input_yuv = INPUT_YUV;
+    int input_stride = 0;
    
     printf("argc %d\n", argc);
     printf("Hello from the Great Gobbler!\n");
 
+    if (argc > 1)
+        input_yuv = argv[1];
+    if (argc > 3) {
+        pic_width = atoi(argv[2]);
+        pic_height = atoi(argv[3]);
+    }
+    if (argc > 4)
+        input_stride = atoi(argv[4]);
+
+    // y4m input brings its own size and rate
+    if (ggi_init(input_yuv, input_stride))
+        return(-1);
+    pic_width = ggi.width;
+    pic_height = ggi.height;
+    if (ggi.fps_num > 0 && ggi.fps_den > 0)
+        ggo_rtp_ts_inc = (int)(90000LL * ggi.fps_den / ggi.fps_num);
+    // Sizes round up to whole macroblocks, the edge macroblocks are padded and cropped in the SPS
+    mb_width = (pic_width + 15) >> 4;
+    mb_height = (pic_height + 15) >> 4;
+    if (pic_width < 2 || pic_height < 2 || (pic_width & 1) || (pic_height & 1) || mb_width * mb_height > GGO_MAX_FS) {
+        printf("ERROR: picture size %dx%d not supported\n", pic_width, pic_height);
+        ggi_close();
+        return(-1);
+    }
+
+    gg_pool_init(&ggo_pool, hugepage_flag, numa_node);
+    printf("Distortion kernels: %s\n", gg_dist_name(gg_dist_init(dist_level)));
+    if (refpic_init()) {
+        ggi_close();
+        return(-1);
+    }
     recon_init("test_stream.yuv");
-    ggo_init("test_stream_grey.264");
+    gg_deblock_open(&dbp, deblock_mode, deblock_async_flag);
+    if (gg_me_open(&ggo_me, mb_width, mb_height, me_range, me_subpel && me_range, me_pyramid && me_range)) {
+        ggi_close();
+        return(-1);
+    }
+    if (ggo_init((avcc_flag) ? "test_stream_grey.avc" : "test_stream_grey.264")) {
+        ggi_close();
+        return(-1);
+    }
     //ggi_init("cheer_if.yuv");
-    ggi_init( INPUT_YUV );
 
     // Grey long term ref
     ggo_sequence_parameter_set();
     ggo_picture_parameter_set();
     ggo_long_term_grey_idc_slice( 1 ); // IDR long term ref
     recon_write_yuv();
-    recon_copy_to_ref(0); // actually where decoder will have it
-    recon_copy_to_ref(1); // after next frame this will be avaiable long term
+    recon_to_ref(0); // actually where decoder will have it
+    ref_share(1, 0); // after next frame this will be avaiable long term
 
     // Grey Skip frame (which puts our long term ref into slot 1
     ggo_sequence_parameter_set();
@@ -976,7 +1334,7 @@ int main( int argc, int **argv )
     //ggo_pskip_slice(); 
     ggo_long_term_grey_idc_slice(0); // grep non-idr pic to push IDR into refidx=1
     recon_write_yuv();
-    recon_copy_to_ref(0);
+    recon_to_ref(0);
 
     // Ref0 P frames
     // ggo_sequence_parameter_set();
@@ -984,15 +1342,16 @@ int main( int argc, int **argv )
     // ggi_read_frame();
     // ggo_inter_0_0_slice(29, 0, 0); // ref0 pintra frame
     // recon_write_yuv();
-    // recon_copy_to_ref(0);
+    // recon_to_ref(0);
 
     for (int ii = 0; ii < 20; ii++) {
+        if (ggi_read_frame())
+            break;
         ggo_sequence_parameter_set();
         ggo_picture_parameter_set();
-        ggi_read_frame();
         ggo_inter_0_0_slice(qp, 0, 1, row_slice_flag ); // pintra refresh cols
         recon_write_yuv();
-        recon_copy_to_ref(0);
+        recon_to_ref(0);
     }
 
     // Ref1 P frames = 'pintra' frames
@@ -1002,11 +1361,22 @@ int main( int argc, int **argv )
     //    ggi_read_frame();
     //    ggo_inter_0_0_slice(qp, 1, 0, 0);
     //    recon_write_yuv();
-    //    recon_copy_to_ref(0);
+    //    recon_to_ref(0);
     //}
 
+    if (avcc_flag) {
+        ggo_write_avcc("test_stream_grey.avcc");
+    }
+    if (psnr_flag)
+        psnr_report();
+    gg_pool_report(&ggo_pool);
     ggo_close();
     recon_close();
+    ggi_close();
+    gg_refpic_close(&ggo_refpic);
+    gg_deblock_free(&dbp);
+    gg_me_close(&ggo_me);
+    gg_pool_close(&ggo_pool);
 
 } 
 